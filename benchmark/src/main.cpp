@@ -0,0 +1,745 @@
+#include "ofMain.h"
+#include "Quad.h"
+#include "QuadCache.h"
+#include "QuadBatch.h"
+#include "QuadBvh.h"
+#include "SubdivisionHierarchy.h"
+#include "Executor.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace ofx;
+
+// One timed measurement, written to JSON output
+struct Result
+{
+    std::string benchmark;
+    std::string mesh;
+    int level;
+    std::size_t numFaces;
+    double ms;
+};
+
+std::vector<Result> results;
+
+void record(std::string benchmark, std::string mesh, int level, std::size_t numFaces, double ms)
+{
+    results.push_back({benchmark, mesh, level, numFaces, ms});
+}
+
+std::string jsonString(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (auto c: text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Write results as JSON, with enough context to compare runs across
+// releases and machines
+void writeJson(const std::string &path)
+{
+    std::ofstream file(path);
+    file << "{\n";
+    file << "  \"context\": {\n";
+    file << "    \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n";
+    file << "    \"timeUnit\": \"ms\"\n";
+    file << "  },\n";
+    file << "  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        auto &result = results[i];
+        file << "    {\"benchmark\": " << jsonString(result.benchmark)
+             << ", \"mesh\": " << jsonString(result.mesh)
+             << ", \"level\": " << result.level
+             << ", \"faces\": " << result.numFaces
+             << ", \"time\": " << result.ms << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n";
+    file << "}\n";
+    if (!file) {
+        cerr << "ERROR: couldn't write " << path << endl;
+    }
+}
+
+// Vertex IDs of each quad of closed torus made of rings * segments quads
+std::vector<std::array<VertexID, 4>> torusFaces(int rings, int segments)
+{
+    std::vector<std::array<VertexID, 4>> faces;
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            VertexID v0 = r * segments + s;
+            VertexID v1 = ((r + 1) % rings) * segments + s;
+            VertexID v2 = ((r + 1) % rings) * segments + (s + 1) % segments;
+            VertexID v3 = r * segments + (s + 1) % segments;
+            faces.push_back({{v0, v1, v2, v3}});
+        }
+    }
+    return faces;
+}
+
+// Closed torus made of rings * segments quads
+Quad makeTorus(int rings, int segments, float radius=100.0, float thickness=40.0)
+{
+    Quad quad;
+    for (int r = 0; r < rings; r++) {
+        float u = TWO_PI * r / rings;
+        for (int s = 0; s < segments; s++) {
+            float v = TWO_PI * s / segments;
+            quad.addVertex({(radius + thickness * cos(v)) * cos(u),
+                            (radius + thickness * cos(v)) * sin(u),
+                            thickness * sin(v)});
+        }
+    }
+    quad.addFaces(torusFaces(rings, segments));
+    return quad;
+}
+
+// Torus with vertices and faces in random order, like meshes exported by
+// tools that don't care about locality
+Quad makeShuffledTorus(int rings, int segments)
+{
+    auto torus = makeTorus(rings, segments);
+    std::mt19937 random(1);
+    std::vector<VertexID> relabel(torus.getNumVertices());
+    for (std::size_t v = 0; v < relabel.size(); v++) {
+        relabel[v] = v;
+    }
+    std::shuffle(relabel.begin(), relabel.end(), random);
+
+    Quad quad;
+    std::vector<ofVec3f> positions(relabel.size());
+    for (std::size_t v = 0; v < relabel.size(); v++) {
+        positions[relabel[v]] = torus.getVertex(v);
+    }
+    for (auto &position: positions) {
+        quad.addVertex(position);
+    }
+    auto faces = torusFaces(rings, segments);
+    for (auto &face: faces) {
+        for (auto &v: face) {
+            v = relabel[v];
+        }
+    }
+    std::shuffle(faces.begin(), faces.end(), random);
+    quad.addFaces(faces);
+    return quad;
+}
+
+// Cube like the one in demo, 8 vertices and 6 faces
+Quad makeCube()
+{
+    Quad quad;
+    auto v0 = quad.addVertex({100.0, -100.0, 100.0});
+    auto v1 = quad.addVertex({100.0, 100.0, 100.0});
+    auto v2 = quad.addVertex({-100.0, 100.0, 100.0});
+    auto v3 = quad.addVertex({-100.0, -100.0, 100.0});
+
+    auto v4 = quad.addVertex({100.0, -100.0, -100.0});
+    auto v5 = quad.addVertex({-100.0, -100.0, -100.0});
+    auto v6 = quad.addVertex({-100.0, 100.0, -100.0});
+    auto v7 = quad.addVertex({100.0, 100.0, -100.0});
+
+    quad.addFace(v0, v1, v2, v3);
+    quad.addFace(v4, v5, v6, v7);
+    quad.addFace(v0, v4, v7, v1);
+    quad.addFace(v3, v2, v6, v5);
+    quad.addFace(v1, v7, v6, v2);
+    quad.addFace(v0, v3, v5, v4);
+    return quad;
+}
+
+// Closed cube whose sides are grids of size * size quads, like a larger
+// cube2.obj
+Quad makeGridCube(int size, float halfWidth=100.0)
+{
+    Quad quad;
+    std::map<std::array<int, 3>, VertexID> vertices;
+    auto vertex = [&](int x, int y, int z) {
+        std::array<int, 3> key = {{x, y, z}};
+        auto found = vertices.find(key);
+        if (found != vertices.end()) {
+            return found->second;
+        }
+        float scale = 2.0 * halfWidth / size;
+        auto id = quad.addVertex({x * scale - halfWidth, y * scale - halfWidth, z * scale - halfWidth});
+        vertices[key] = id;
+        return id;
+    };
+
+    // Each side is spanned by axes u and v at fixed w, wound so that
+    // normals point outwards
+    std::vector<std::array<VertexID, 4>> faces;
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+            for (int i = 0; i < size; i++) {
+                for (int j = 0; j < size; j++) {
+                    std::array<VertexID, 4> face;
+                    int corners[4][2] = {{i, j}, {i + 1, j}, {i + 1, j + 1}, {i, j + 1}};
+                    for (int k = 0; k < 4; k++) {
+                        int c = side ? k : 3 - k;
+                        int p[3];
+                        p[axis] = side * size;
+                        p[(axis + 1) % 3] = corners[c][0];
+                        p[(axis + 2) % 3] = corners[c][1];
+                        face[k] = vertex(p[0], p[1], p[2]);
+                    }
+                    faces.push_back(face);
+                }
+            }
+        }
+    }
+    quad.addFaces(faces);
+    return quad;
+}
+
+// Write torus as OBJ file for load benchmark
+void writeTorusObj(const std::string &path, int rings, int segments)
+{
+    auto torus = makeTorus(rings, segments);
+    std::ofstream file(path);
+    for (std::size_t v = 0; v < torus.getNumVertices(); v++) {
+        auto p = torus.getVertex(v);
+        file << "v " << p.x << " " << p.y << " " << p.z << "\n";
+    }
+    for (auto &f: torusFaces(rings, segments)) {
+        file << "f " << f[0] + 1 << " " << f[1] + 1 << " " << f[2] + 1 << " " << f[3] + 1 << "\n";
+    }
+}
+
+// Run function repeatedly and return fastest time in milliseconds
+double timeMs(std::function<void()> function, int repeats)
+{
+    double best = 0.0;
+    for (int i = 0; i < repeats; i++) {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        function();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        if (i == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+// Levels whose output stays below this many faces are benchmarked
+const std::size_t maxBenchmarkFaces = std::size_t(1) << 23;
+
+int repeatsFor(std::size_t numFaces)
+{
+    return numFaces < 100000 ? 5 : numFaces < 1000000 ? 3 : 1;
+}
+
+void benchmarkLoad(std::string name, std::string path)
+{
+    Quad quad;
+    try {
+        quad.load(path);
+    }
+    catch (std::exception &error) {
+        cout << name << " load skipped: " << error.what() << endl;
+        return;
+    }
+    auto ms = timeMs([&] { Quad loaded; loaded.load(path); }, repeatsFor(quad.getNumFaces()));
+    record("load", name, 0, quad.getNumFaces(), ms);
+    cout << name << " load (" << quad.getNumFaces() << " faces): " << ms << " ms" << endl;
+}
+
+// Subdivision, normals and render buffers at levels 1 to 7, as far as
+// output stays below maxBenchmarkFaces
+void benchmarkLevels(std::string name, const Quad &quad)
+{
+    for (int level = 1; level <= 7; level++) {
+        auto numFaces = quad.getNumFaces() << (2 * level);
+        if (numFaces > maxBenchmarkFaces) {
+            break;
+        }
+        int repeats = repeatsFor(numFaces);
+
+        auto subdivideMs = timeMs([&] { quad.subdivide(level); }, repeats);
+        record("subdivide", name, level, numFaces, subdivideMs);
+
+        auto subdivided = quad.subdivide(level);
+        auto normalsMs = timeMs([&] { subdivided.calculateNormals(); }, repeats);
+        record("calculateNormals", name, level, numFaces, normalsMs);
+
+        double bufferMs[2];
+        for (int smooth = 0; smooth < 2; smooth++) {
+            std::size_t numVertices, numIndices;
+            subdivided.getRenderBufferSize(smooth, numVertices, numIndices);
+            std::vector<ofVec3f> positions(numVertices), normals(numVertices);
+            std::vector<ofIndexType> indices(numIndices);
+            bufferMs[smooth] = timeMs([&] {
+                subdivided.fillRenderBuffer(smooth, positions.data(), normals.data(), indices.data());
+            }, repeats);
+            record(smooth ? "renderBufferSmooth" : "renderBufferFlat", name, level, numFaces,
+                   bufferMs[smooth]);
+        }
+
+        cout << name << " level " << level << " (" << numFaces << " faces)"
+             << ": subdivide " << subdivideMs << " ms"
+             << ", normals " << normalsMs << " ms"
+             << ", smooth buffer " << bufferMs[1] << " ms"
+             << ", flat buffer " << bufferMs[0] << " ms" << endl;
+    }
+}
+
+// Vertices transformed per triangle with a FIFO post-transform cache of
+// given size, for smooth shaded render buffer. 0.5 is ideal for a regular
+// quad mesh, 3 means no reuse at all.
+double vertexCacheMissRatio(const Quad &quad, std::size_t cacheSize=32)
+{
+    std::size_t numVertices, numIndices;
+    quad.getRenderBufferSize(true, numVertices, numIndices);
+    std::vector<ofVec3f> positions(numVertices), normals(numVertices);
+    std::vector<ofIndexType> indices(numIndices);
+    quad.fillRenderBuffer(true, positions.data(), normals.data(), indices.data());
+
+    std::vector<std::size_t> cachedAt(numVertices, 0);
+    std::size_t misses = 0;
+    for (auto index: indices) {
+        // Vertex is cached if it was loaded within last cacheSize misses
+        if (cachedAt[index] == 0 || misses - cachedAt[index] >= cacheSize) {
+            misses++;
+            cachedAt[index] = misses;
+        }
+    }
+    return numIndices ? double(misses) / (numIndices / 3) : 0.0;
+}
+
+// Subdivision, normals and vertex cache reuse after each reorder. Orders
+// only change IDs, so all variants are the same mesh.
+void benchmarkOrder(std::string name, const Quad &quad)
+{
+    struct Variant
+    {
+        std::string name;
+        bool reorder;
+        MeshOrder order;
+    };
+    std::vector<Variant> variants = {
+        {"original", false, MeshOrder::FirstTouch},
+        {"firstTouch", true, MeshOrder::FirstTouch},
+        {"morton", true, MeshOrder::Morton},
+        {"breadth", true, MeshOrder::Breadth}
+    };
+    auto numFaces = quad.getNumFaces();
+    int repeats = repeatsFor(4 * numFaces);
+    for (auto &variant: variants) {
+        Quad ordered = quad;
+        double reorderMs = 0.0;
+        if (variant.reorder) {
+            reorderMs = timeMs([&] { Quad copy = quad; copy.reorder(variant.order); }, repeats);
+            ordered.reorder(variant.order);
+        }
+        auto subdivideMs = timeMs([&] { ordered.subdivide(1); }, repeats);
+        auto normalsMs = timeMs([&] { ordered.calculateNormals(); }, repeats);
+        auto missRatio = vertexCacheMissRatio(ordered);
+
+        auto label = name + " " + variant.name;
+        record("reorder", label, 0, numFaces, reorderMs);
+        record("subdivide", label, 1, 4 * numFaces, subdivideMs);
+        record("calculateNormals", label, 0, numFaces, normalsMs);
+        cout << label << ": reorder " << reorderMs << " ms, subdivide " << subdivideMs
+             << " ms, normals " << normalsMs << " ms, vertex cache misses per triangle "
+             << missRatio << endl;
+    }
+}
+
+// Subdivision with and without reordering mesh first, and normals of
+// result
+void benchmarkOrderedSubdivision(std::string name, const Quad &quad, int level)
+{
+    SubdivideOptions options;
+    int repeats = repeatsFor(quad.getNumFaces() << (2 * level));
+    for (int reorder = 0; reorder < 2; reorder++) {
+        options.reorder = reorder;
+        auto subdivideMs = timeMs([&] { quad.subdivide(level, options); }, repeats);
+        auto subdivided = quad.subdivide(level, options);
+        auto normalsMs = timeMs([&] { subdivided.calculateNormals(); }, repeats);
+        auto missRatio = vertexCacheMissRatio(subdivided);
+
+        auto label = name + (reorder ? " morton" : " original");
+        record("subdivide", label, level, subdivided.getNumFaces(), subdivideMs);
+        record("calculateNormals", label, level, subdivided.getNumFaces(), normalsMs);
+        cout << label << " level " << level << ": subdivide " << subdivideMs << " ms, normals "
+             << normalsMs << " ms, vertex cache misses per triangle " << missRatio << endl;
+    }
+}
+
+// Many small meshes subdivided and turned into render buffers one by one,
+// and as one QuadBatch
+void benchmarkBatch(std::size_t numMeshes, int level)
+{
+    std::vector<Quad> meshes;
+    for (std::size_t i = 0; i < numMeshes; i++) {
+        meshes.push_back(i % 2 ? makeCube() : makeTorus(8, 4));
+    }
+    QuadBatch batch;
+    for (auto &mesh: meshes) {
+        batch.add(mesh);
+    }
+    auto name = std::to_string(numMeshes) + " meshes";
+    auto numFaces = batch.getQuad().getNumFaces() << (2 * level);
+    int repeats = repeatsFor(numFaces);
+
+    // Fill smooth render buffer of a mesh with normals
+    auto fill = [](const Quad &quad) {
+        std::size_t numVertices, numIndices;
+        quad.getRenderBufferSize(true, numVertices, numIndices);
+        std::vector<ofVec3f> positions(numVertices);
+        std::vector<ofVec3f> normals(numVertices);
+        std::vector<ofIndexType> indices(numIndices);
+        quad.fillRenderBuffer(true, positions.data(), normals.data(), indices.data());
+    };
+
+    // Subdivide, calculate normals and fill buffers, per mesh or once for
+    // batch. Subdivided meshes are kept, as they would be for drawing.
+    auto separateMs = timeMs([&] {
+        std::vector<Quad> subdivided;
+        subdivided.reserve(meshes.size());
+        for (auto &mesh: meshes) {
+            subdivided.push_back(mesh.subdivide(level));
+            subdivided.back().calculateNormals();
+            fill(subdivided.back());
+        }
+    }, repeats);
+    auto batchMs = timeMs([&] {
+        fill(batch.subdivide(level).getQuad());
+    }, repeats);
+
+    ThreadPoolExecutor executor;
+    SubdivideOptions options;
+    options.executor = &executor;
+    auto parallelMs = timeMs([&] { batch.subdivide(level, options); }, repeats);
+
+    record("separateMeshes", name, level, numFaces, separateMs);
+    record("batch", name, level, numFaces, batchMs);
+    record("batchSubdivideParallel", name, level, numFaces, parallelMs);
+    cout << name << " level " << level << ": separate " << separateMs << " ms, batch " << batchMs
+         << " ms, speedup " << separateMs / batchMs << "x, batch subdivision with "
+         << executor.getNumThreads() << " threads " << parallelMs << " ms" << endl;
+}
+
+// Subdivision with a vertex color channel and face-varying texture
+// coordinates, against positions only
+void benchmarkAttributes(std::string name, const Quad &quad, int level)
+{
+    auto withAttributes = quad;
+    withAttributes.addAttribute("color", 3);
+    withAttributes.addAttribute("uv", 2, AttributeRule::FaceVarying);
+    auto numFaces = quad.getNumFaces() << (2 * level);
+    int repeats = repeatsFor(numFaces);
+
+    auto positionsMs = timeMs([&] { quad.subdivide(level); }, repeats);
+    auto attributesMs = timeMs([&] { withAttributes.subdivide(level); }, repeats);
+    record("subdivide", name, level, numFaces, positionsMs);
+    record("subdivideAttributes", name, level, numFaces, attributesMs);
+    cout << name << " level " << level << ": positions " << positionsMs
+         << " ms, with color and uv " << attributesMs << " ms" << endl;
+}
+
+// Hierarchy build and refit, and picking and snapping queries against
+// each level. Rays go from around mesh towards its middle, and snapped
+// points lie near control vertices. Query time should grow with depth of
+// hierarchy, not with number of faces.
+void benchmarkPicking(std::string name, const Quad &quad, int maxLevel)
+{
+    const int numQueries = 10000;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform(-1.0, 1.0);
+    auto randomVector = [&] { return ofVec3f(uniform(random), uniform(random), uniform(random)); };
+    std::vector<ofVec3f> origins;
+    std::vector<ofVec3f> targets;
+    std::vector<ofVec3f> points;
+    for (int i = 0; i < numQueries; i++) {
+        origins.push_back(randomVector() * 300.0);
+        targets.push_back(randomVector() * 100.0);
+        points.push_back(quad.getVertex(random() % quad.getNumVertices()) + randomVector() * 10.0);
+    }
+    ThreadPoolExecutor executor;
+
+    for (int level = 1; level <= maxLevel; level++) {
+        auto subdivided = quad.subdivide(level);
+        auto numFaces = subdivided.getNumFaces();
+        int repeats = repeatsFor(numFaces);
+        auto buildMs = timeMs([&] { QuadBvh bvh(subdivided); }, repeats);
+        auto parallelMs = timeMs([&] { QuadBvh bvh(subdivided, &executor); }, repeats);
+        QuadBvh bvh(subdivided);
+        auto refitMs = timeMs([&] { bvh.refit(subdivided); }, repeats);
+
+        int numHits = 0;
+        auto rayMs = timeMs([&] {
+            numHits = 0;
+            for (int i = 0; i < numQueries; i++) {
+                QuadHit hit;
+                numHits += bvh.intersect(subdivided, origins[i], targets[i] - origins[i], hit);
+            }
+        }, 3);
+        auto closestMs = timeMs([&] {
+            for (int i = 0; i < numQueries; i++) {
+                QuadPoint point;
+                bvh.closestPoint(subdivided, points[i], point);
+            }
+        }, 3);
+
+        record("bvhBuild", name, level, numFaces, buildMs);
+        record("bvhBuildParallel", name, level, numFaces, parallelMs);
+        record("bvhRefit", name, level, numFaces, refitMs);
+        record("bvhRays", name, level, numFaces, rayMs);
+        record("bvhClosestPoints", name, level, numFaces, closestMs);
+        cout << name << " level " << level << ": bvh build " << buildMs << " ms ("
+             << parallelMs << " ms with " << executor.getNumThreads() << " threads), refit " << refitMs
+             << " ms, " << numQueries << " rays " << rayMs << " ms (" << numHits << " hits), "
+             << numQueries << " closest points " << closestMs << " ms" << endl;
+    }
+}
+
+void benchmarkTopology(std::string name, Quad &quad, int maxLevel)
+{
+    SubdivideOptions direct;
+    SubdivideOptions addFace;
+    addFace.directTopology = false;
+
+    for (int level = 1; level <= maxLevel; level++) {
+        int repeats = level < 5 ? 5 : 1;
+        auto directMs = timeMs([&] { quad.subdivide(level, direct); }, repeats);
+        auto addFaceMs = timeMs([&] { quad.subdivide(level, addFace); }, repeats);
+        auto numFaces = quad.getNumFaces() << (2 * level);
+        record("subdivideDirectTopology", name, level, numFaces, directMs);
+        record("subdivideAddFace", name, level, numFaces, addFaceMs);
+        cout << name << " level " << level
+             << ": direct " << directMs << " ms"
+             << ", addFace " << addFaceMs << " ms"
+             << ", speedup " << addFaceMs / directMs << "x" << endl;
+    }
+}
+
+// Building a subdivided level against reading it back from a cache file
+void benchmarkCache(std::string name, Quad &quad, int level)
+{
+    std::string path = "benchmark_cache.bin";
+    auto subdivided = quad.subdivide(level);
+    QuadCache::write(path, {&quad, &subdivided});
+
+    auto subdivideMs = timeMs([&] { quad.subdivide(level); }, 3);
+    auto cacheMs = timeMs([&] { QuadCache(path).getLevel(1); }, 3);
+    std::remove(path.c_str());
+    record("subdivideUncached", name, level, subdivided.getNumFaces(), subdivideMs);
+    record("cacheLoad", name, level, subdivided.getNumFaces(), cacheMs);
+
+    cout << name << " level " << level
+         << ": subdivide " << subdivideMs << " ms"
+         << ", cache " << cacheMs << " ms"
+         << ", speedup " << subdivideMs / cacheMs << "x" << endl;
+}
+
+void benchmarkFaceInsertion(int rings, int segments)
+{
+    auto faces = torusFaces(rings, segments);
+    auto numVertices = rings * segments;
+
+    auto addFaceMs = timeMs([&] {
+        Quad quad;
+        for (int i = 0; i < numVertices; i++) {
+            quad.addVertex({0.0, 0.0, 0.0});
+        }
+        for (auto &f: faces) {
+            quad.addFace(f[0], f[1], f[2], f[3]);
+        }
+    }, 1);
+    auto addFacesMs = timeMs([&] {
+        Quad quad;
+        for (int i = 0; i < numVertices; i++) {
+            quad.addVertex({0.0, 0.0, 0.0});
+        }
+        quad.addFaces(faces);
+    }, 1);
+    auto name = "torus " + std::to_string(rings) + "x" + std::to_string(segments);
+    record("addFace", name, 0, faces.size(), addFaceMs);
+    record("addFaces", name, 0, faces.size(), addFacesMs);
+    cout << faces.size() << " faces: addFace " << addFaceMs << " ms"
+         << ", addFaces " << addFacesMs << " ms"
+         << ", speedup " << addFaceMs / addFacesMs << "x" << endl;
+}
+
+// Check draw buffers built without OpenGL against mesh they came from.
+// Mesh must be closed. Prints first failure and returns false.
+bool checkDrawBuffers(std::string name, Quad quad)
+{
+    auto fail = [&](std::string what) {
+        cout << name << " draw buffer check failed: " << what << endl;
+        return false;
+    };
+
+    quad.calculateNormals();
+    auto numFaces = quad.getNumFaces();
+    for (bool smoothShading: {true, false}) {
+        std::size_t numVertices, numIndices;
+        quad.getRenderBufferSize(smoothShading, numVertices, numIndices);
+        auto expectedVertices = smoothShading ? quad.getNumVertices() : 4 * numFaces;
+        if (numVertices != expectedVertices || numIndices != 6 * numFaces) {
+            return fail("buffer size");
+        }
+
+        std::vector<ofVec3f> positions(numVertices);
+        std::vector<ofVec3f> normals(numVertices);
+        std::vector<ofIndexType> indices(numIndices);
+        quad.fillRenderBuffer(smoothShading, positions.data(), normals.data(), indices.data());
+        for (auto index: indices) {
+            if (index >= numVertices) {
+                return fail("index out of range");
+            }
+        }
+        if (smoothShading) {
+            for (std::size_t v = 0; v < numVertices; v++) {
+                if (positions[v] != quad.getVertex(v)) {
+                    return fail("smooth position");
+                }
+            }
+        }
+        else {
+            // Four render vertices per face sharing face normal
+            for (std::size_t face = 0; face < numFaces; face++) {
+                for (int corner = 1; corner < 4; corner++) {
+                    if (normals[4 * face + corner] != normals[4 * face]) {
+                        return fail("flat normal");
+                    }
+                }
+            }
+        }
+    }
+
+    // Each edge of closed mesh is shared by two faces and listed once
+    std::vector<ofIndexType> lines(quad.getWireframeIndexCount());
+    quad.fillWireframeIndices(lines.data());
+    std::set<std::pair<ofIndexType, ofIndexType>> edges;
+    for (std::size_t i = 0; i + 1 < lines.size(); i += 2) {
+        edges.insert(std::minmax(lines[i], lines[i + 1]));
+    }
+    if (lines.size() != 4 * numFaces || edges.size() != 2 * numFaces) {
+        return fail("wireframe edge count");
+    }
+    return true;
+}
+
+// Check that editing control mesh through SubdivisionHierarchy gives
+// points and normals bit for bit equal to subdividing it again
+bool checkHierarchy(std::string name, Quad control, int level)
+{
+    SubdivisionHierarchy hierarchy(control, level);
+    hierarchy.getSubdivided().calculateNormals();
+    std::vector<VertexID> moved;
+    for (std::size_t v = 0; v < control.getNumVertices(); v += 7) {
+        control.setVertex(v, control.getVertex(v) * 1.1f);
+        moved.push_back(v);
+    }
+    hierarchy.update(control, moved);
+
+    auto fresh = control.subdivide(level);
+    fresh.calculateNormals();
+    std::size_t numVertices, numIndices;
+    fresh.getRenderBufferSize(true, numVertices, numIndices);
+    std::vector<ofVec3f> positions[2], normals[2];
+    std::vector<ofIndexType> indices(numIndices);
+    Quad *quads[2] = {&hierarchy.getSubdivided(), &fresh};
+    for (int i = 0; i < 2; i++) {
+        positions[i].resize(numVertices);
+        normals[i].resize(numVertices);
+        quads[i]->fillRenderBuffer(true, positions[i].data(), normals[i].data(), indices.data());
+    }
+    auto bytes = numVertices * sizeof(ofVec3f);
+    if (std::memcmp(positions[0].data(), positions[1].data(), bytes) != 0 ||
+        std::memcmp(normals[0].data(), normals[1].data(), bytes) != 0) {
+        cout << name << " hierarchy check failed: update differs from subdivide()" << endl;
+        return false;
+    }
+    return true;
+}
+
+void printUsage()
+{
+    cout << "USAGE: benchmark [-o results.json] [-m cube2.obj]" << endl;
+}
+
+// Headless benchmark of mesh core; doesn't open a window. Results are
+// printed and, with -o, written as JSON.
+int main(int argc, char **argv)
+{
+    std::string jsonPath;
+    std::string cube2Path = "../../example/bin/cube2.obj";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "-o" || arg == "-m") && i + 1 < argc) {
+            (arg == "-o" ? jsonPath : cube2Path) = argv[++i];
+        }
+        else {
+            printUsage();
+            return arg == "-h" ? 0 : 1;
+        }
+    }
+
+    if (!checkDrawBuffers("cube", makeCube()) ||
+        !checkDrawBuffers("cube level 2", makeCube().subdivide(2)) ||
+        !checkHierarchy("cube", makeCube(), 3) ||
+        !checkHierarchy("torus 32x16", makeTorus(32, 16), 2)) {
+        return 1;
+    }
+
+    std::string objPath = "benchmark_torus.obj";
+    writeTorusObj(objPath, 512, 256);
+    benchmarkLoad("cube2", cube2Path);
+    benchmarkLoad("torus 512x256", objPath);
+    std::remove(objPath.c_str());
+
+    benchmarkFaceInsertion(1000, 1000);
+
+    benchmarkLevels("cube", makeCube());
+    Quad cube2;
+    try {
+        cube2.load(cube2Path);
+        benchmarkLevels("cube2", cube2);
+    }
+    catch (std::exception &error) {
+        cout << "cube2 skipped: " << error.what() << endl;
+    }
+    benchmarkLevels("grid cube 32", makeGridCube(32));
+    benchmarkLevels("torus 64x32", makeTorus(64, 32));
+
+    auto torus = makeTorus(32, 16);
+    benchmarkTopology("torus", torus, 5);
+
+    auto largeTorus = makeTorus(64, 32);
+    benchmarkCache("torus", largeTorus, 4);
+
+    benchmarkBatch(4000, 1);
+    benchmarkBatch(4000, 3);
+
+    benchmarkPicking("torus 64x32", largeTorus, 4);
+    benchmarkAttributes("torus 64x32", largeTorus, 4);
+
+    auto shuffledTorus = makeShuffledTorus(512, 256);
+    benchmarkOrder("shuffled torus 512x256", shuffledTorus);
+    benchmarkOrderedSubdivision("shuffled torus 512x256", shuffledTorus, 2);
+
+    if (!jsonPath.empty()) {
+        writeJson(jsonPath);
+    }
+    return 0;
+}
@@ -2,8 +2,10 @@
 #include <chrono>
 
 
-QuadDemo::QuadDemo(std::string meshName, int numSubdivisions, bool wireframe, bool smooth)
-    : _meshName(meshName), _numSubdivisions(numSubdivisions), _wireframe(wireframe), _smooth(smooth)
+QuadDemo::QuadDemo(std::string meshName, int numSubdivisions, bool wireframe, bool smooth, bool limit,
+                   int numThreads)
+    : _meshName(meshName), _numSubdivisions(numSubdivisions), _wireframe(wireframe), _smooth(smooth),
+      _limit(limit), _numThreads(numThreads), _subdivisionReported(false), _detailDistance(0.0)
 {
 
 }
@@ -42,17 +44,18 @@ void QuadDemo::setup()
         _quad.addFace(v0, v3, v5, v4);
     }
     else if (_meshName == "cube2") {
-        _quad.load("cube2.obj");
+        _quad.load("./bin/cube2.obj");
     }
     else {
         cerr << "ERROR: Mesh " << _meshName << " not found" << endl;
     }
 
-    auto t0 = std::chrono::high_resolution_clock::now();
-    _quad = _quad.subdivide(_numSubdivisions);
-    auto t1 = std::chrono::high_resolution_clock::now();
-    float seconds = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000000.0;
-    cout << "subdivision took " << seconds << " seconds" << endl;
+    _executor.reset(new ofx::ThreadPoolExecutor(_numThreads));
+    ofx::SubdivideOptions options;
+    options.executor = _executor.get();
+    options.limitSurface = _limit;
+    _subdivisionStart = std::chrono::steady_clock::now();
+    _subdivision.reset(new ofx::AsyncSubdivision(std::move(_quad), _numSubdivisions, options));
 }
 
 
@@ -66,17 +69,28 @@ void QuadDemo::draw()
     _light2.enable();
     _material.begin();
     _camera.begin();
+    if (_detailDistance <= 0.0) {
+        _detailDistance = _camera.getDistance();
+    }
+    int level = ofx::getLevelForDistance(_subdivision->getTargetLevel(), _camera.getDistance(),
+                                         _detailDistance);
+    if (!_subdivisionReported && _subdivision->isDone()) {
+        auto elapsed = std::chrono::steady_clock::now() - _subdivisionStart;
+        cout << "subdivision took " << std::chrono::duration<float>(elapsed).count() << " seconds" << endl;
+        _subdivisionReported = true;
+    }
 
     ofRotateY(45.0);
     ofRotateX(15.0);
     ofRotateZ(15.0);
     ofScale(2, 2, 2);
 
+    // Finest level built so far is drawn until requested one is ready
     if (_wireframe) {
-        _quad.drawWireframe();
+        _subdivision->drawWireframe(level);
     }
     else {
-        _quad.draw(_smooth);
+        _subdivision->draw(level, _smooth);
     }
     
     _camera.end();
@@ -88,3 +102,16 @@ void QuadDemo::draw()
         ofSaveFrame();
     }
 }
+
+
+// + and - change subdivision level; levels above new one stop building
+void QuadDemo::keyPressed(int key)
+{
+    int level = _subdivision->getTargetLevel();
+    if ((key == '+' || key == '=') && level < _subdivision->getMaxLevel()) {
+        _subdivision->setTargetLevel(level + 1);
+    }
+    else if (key == '-' && level > 0) {
+        _subdivision->setTargetLevel(level - 1);
+    }
+}
@@ -4,14 +4,21 @@
 
 #include "ofMain.h"
 #include "../src/Quad.h"
+#include "../src/QuadLod.h"
+#include "../src/AsyncSubdivision.h"
+#include "../src/Executor.h"
+#include <memory>
+#include <chrono>
 
 
 class QuadDemo : public ofBaseApp
 {
 public:
-    QuadDemo(std::string meshName, int numSubdivisions, bool wireframe, bool smooth);
+    QuadDemo(std::string meshName, int numSubdivisions, bool wireframe, bool smooth, bool limit,
+             int numThreads);
     void setup();
     void draw();
+    void keyPressed(int key);
 
 private:
     ofEasyCam _camera;
@@ -25,6 +32,17 @@ private:
     int _numSubdivisions;
     bool _wireframe;
     bool _smooth;
+    bool _limit;
+    int _numThreads;
+
+    std::unique_ptr<ofx::ThreadPoolExecutor> _executor;
+    // Levels up to _numSubdivisions, built in background; coarser ones are
+    // drawn when camera moves away
+    std::unique_ptr<ofx::AsyncSubdivision> _subdivision;
+    std::chrono::steady_clock::time_point _subdivisionStart;
+    bool _subdivisionReported;
+    // Camera distance at which finest level is drawn
+    float _detailDistance;
 };
 
 
@@ -11,12 +11,13 @@ enum class ArgMode
     NONE,
     MESH,
     LEVEL,
-    SHADING
+    SHADING,
+    THREADS
 };
 
 void printUsage()
 {
-    cout << "USAGE: example -m mesh_name -l subdivision_level -s wireframe|flat|smooth" << endl;
+    cout << "USAGE: example -m mesh_name -l subdivision_level -s wireframe|flat|smooth|limit -t num_threads" << endl;
 }
 
 int main(int argc, char **argv)
@@ -25,6 +26,8 @@ int main(int argc, char **argv)
     int numSubdivisions = 1;
     bool wireframe = false;
     bool smooth = true;
+    bool limit = false;
+    int numThreads = 1;
 
     // quick n dirty command line argument parsing
     vector<string> arguments(argv, argv + argc);
@@ -42,6 +45,14 @@ int main(int argc, char **argv)
                     return 1;
                 }
             }
+            else if (argMode == ArgMode::THREADS) {
+                istringstream iss(arg);
+                iss >> numThreads;
+                if (!iss.eof() || numThreads < 1) {
+                    cerr << "ERROR: positive integer required for number of threads" << endl;
+                    return 1;
+                }
+            }
             else if (argMode == ArgMode::SHADING) {
                 if (arg == "wireframe") {
                     wireframe = true;
@@ -55,6 +66,11 @@ int main(int argc, char **argv)
                     wireframe = false;
                     smooth = true;
                 }
+                else if (arg == "limit") {
+                    wireframe = false;
+                    smooth = true;
+                    limit = true;
+                }
                 else {
                     cerr << "ERROR: invalid shading type" << endl;
                     printUsage();
@@ -72,6 +88,9 @@ int main(int argc, char **argv)
         else if (arg == "-s") {
             argMode = ArgMode::SHADING;
         }
+        else if (arg == "-t") {
+            argMode = ArgMode::THREADS;
+        }
         else if (arg == "-h") {
             printUsage();
             return 0;
@@ -88,6 +107,9 @@ int main(int argc, char **argv)
         else if (argMode == ArgMode::SHADING) {
             cerr << "ERROR: missing shading type" << endl;
         }
+        else if (argMode == ArgMode::THREADS) {
+            cerr << "ERROR: missing number of threads" << endl;
+        }
         printUsage();
         return 1;
     }
@@ -96,7 +118,7 @@ int main(int argc, char **argv)
     ofSetCurrentRenderer(ofGLProgrammableRenderer::TYPE);
     ofSetOpenGLVersion(4, 4);
     ofSetupOpenGL(&window, 1024, 768, OF_WINDOW);
-    ofRunApp(new QuadDemo(meshName, numSubdivisions, wireframe, smooth));
+    ofRunApp(new QuadDemo(meshName, numSubdivisions, wireframe, smooth, limit, numThreads));
 
     return 0;
 }
@@ -0,0 +1,342 @@
+#include "AdaptiveSubdivision.h"
+#include "Executor.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+
+
+namespace
+{
+
+// Number of items handled per block in parallel loops
+const size_t blockSize = 4096;
+
+// Call fn for every face around start vertex of edge on a closed mesh
+template<typename Fn>
+void forEachVertexFace(const vector<Edge> &edges, EdgeID edge, Fn fn)
+{
+    auto e = edge;
+    do {
+        fn(Quad::edgeFace(e));
+        e = Quad::nextEdge(edges[e].opposite);
+    } while (e != edge);
+}
+
+// Level needed to bring ratio down to 1 when each level halves it
+int halvingLevels(float ratio, int maxLevel)
+{
+    if (!(ratio > 1.0f)) {
+        return 0;
+    }
+    return min(int(ceil(log2(ratio))), maxLevel);
+}
+
+};
+
+
+AdaptiveSubdivision::AdaptiveSubdivision(const Quad &control, const vector<int> &faceLevels)
+    : _control(control), _faceLevels(faceLevels)
+{
+    if (_faceLevels.size() != control._faces.size()) {
+        throw invalid_argument("number of face levels doesn't match number of faces");
+    }
+    for (auto &edge: control._edges) {
+        if (edge.opposite == -1) {
+            throw invalid_argument("adaptive subdivision requires a closed mesh");
+        }
+    }
+    for (auto &level: _faceLevels) {
+        level = max(level, 0);
+    }
+    balanceLevels();
+}
+
+AdaptiveSubdivision::AdaptiveSubdivision(const Quad &control,
+                                         const function<int(FaceID)> &faceLevel)
+    : AdaptiveSubdivision(control, [&]() {
+          vector<int> levels(control._faces.size());
+          for (size_t face = 0; face < levels.size(); face++) {
+              levels[face] = faceLevel(face);
+          }
+          return levels;
+      }())
+{
+
+}
+
+const vector<int> &AdaptiveSubdivision::getFaceLevels() const
+{
+    return _faceLevels;
+}
+
+// Raise levels until faces sharing a vertex differ by at most one level.
+// Faces are visited from highest level down; raising a face only ever
+// moves it to a lower bucket than the one being processed, so each face
+// is processed at its final level. Stale bucket entries are skipped.
+void AdaptiveSubdivision::balanceLevels()
+{
+    auto &edges = _control._edges;
+    int maxLevel = 0;
+    for (auto level: _faceLevels) {
+        maxLevel = max(maxLevel, level);
+    }
+
+    vector<vector<FaceID>> buckets(maxLevel + 1);
+    for (size_t face = 0; face < _faceLevels.size(); face++) {
+        buckets[_faceLevels[face]].push_back(face);
+    }
+    for (int level = maxLevel; level > 1; level--) {
+        for (size_t i = 0; i < buckets[level].size(); i++) {
+            auto face = buckets[level][i];
+            if (_faceLevels[face] != level) {
+                continue;
+            }
+            for (int corner = 0; corner < 4; corner++) {
+                forEachVertexFace(edges, Quad::faceEdge(face, corner), [&](FaceID other) {
+                    if (_faceLevels[other] < level - 1) {
+                        _faceLevels[other] = level - 1;
+                        buckets[level - 1].push_back(other);
+                    }
+                });
+            }
+        }
+    }
+}
+
+// Refine level by level. Level k mesh holds every face of level k whose
+// control face has target level k or higher; faces with higher target are
+// refined into level k + 1, and faces with target k are emitted. Each
+// vertex of level meshes has a global ID, shared with its vertex point in
+// the next level, and gets its limit position once, at the first level
+// where it has a closed ring of faces. Edge points on border between a
+// refined face and an emitted one never get a closed ring; they are put
+// halfway between limit positions of edge endpoints instead, which is on
+// the edge drawn by emitted face.
+Quad AdaptiveSubdivision::createQuad(Executor *executor) const
+{
+    vector<ofVec3f> positions;
+    vector<ofVec3f> normals;
+    // Global IDs of hanging edge point and its edge endpoints
+    vector<array<VertexID, 3>> hanging;
+    vector<array<VertexID, 4>> outputFaces;
+
+    // Limit position and normal of vertices from firstNew on, by global ID.
+    // Returns whether each vertex has a closed ring.
+    auto computeLimits = [&](const Quad &quad, const vector<VertexID> &globalIds,
+                             VertexID firstNew) {
+        vector<EdgeID> vertexEdges(quad._vertices.size(), -1);
+        for (size_t edge = 0; edge < quad._edges.size(); edge++) {
+            vertexEdges[quad._edges[edge].vertex] = edge;
+        }
+        vector<char> closed(quad._vertices.size(), 1);
+        parallelForBlocks(executor, quad._vertices.size() - firstNew, blockSize, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i++) {
+                auto v = firstNew + i;
+                auto id = globalIds[v];
+                closed[v] = vertexEdges[v] != -1 &&
+                            quad.limitPoint(vertexEdges[v], positions[id], normals[id]);
+            }
+        });
+        return closed;
+    };
+
+    // Level 0 is control mesh itself
+    Quad level = _control;
+    vector<VertexID> globalIds(level._vertices.size());
+    vector<FaceID> faceBase(level._faces.size());
+    for (size_t v = 0; v < globalIds.size(); v++) {
+        globalIds[v] = v;
+    }
+    for (size_t face = 0; face < faceBase.size(); face++) {
+        faceBase[face] = face;
+    }
+    VertexID numGlobal = globalIds.size();
+    positions.resize(numGlobal);
+    normals.resize(numGlobal);
+    computeLimits(level, globalIds, 0);
+
+    for (int k = 0; !level._faces.empty(); k++) {
+        vector<FaceID> refined;
+        for (size_t face = 0; face < level._faces.size(); face++) {
+            if (_faceLevels[faceBase[face]] == k) {
+                array<VertexID, 4> corners;
+                for (int corner = 0; corner < 4; corner++) {
+                    corners[corner] = globalIds[level._edges[Quad::faceEdge(face, corner)].vertex];
+                }
+                outputFaces.push_back(corners);
+            }
+            else {
+                refined.push_back(face);
+            }
+        }
+        if (refined.empty()) {
+            break;
+        }
+
+        vector<Vertex> facePoints(level._faces.size());
+        parallelForBlocks(executor, facePoints.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto face = begin; face < end; face++) {
+                facePoints[face].position = level.facePoint(face);
+            }
+        });
+
+        // Vertex points come first so that new points start at firstNew
+        Quad child;
+        vector<VertexID> childGlobalIds;
+        vector<VertexID> vertexChild(level._vertices.size(), -1);
+        for (auto face: refined) {
+            for (int corner = 0; corner < 4; corner++) {
+                auto edge = Quad::faceEdge(face, corner);
+                auto v = level._edges[edge].vertex;
+                if (vertexChild[v] == -1) {
+                    vertexChild[v] = child._vertices.size();
+                    child._vertices.push_back({level.vertexPoint(edge, facePoints.data()), {}});
+                    childGlobalIds.push_back(globalIds[v]);
+                }
+            }
+        }
+        VertexID firstNew = child._vertices.size();
+
+        vector<VertexID> edgeChild(level._edges.size(), -1);
+        vector<array<VertexID, 4>> childFaces;
+        vector<FaceID> childFaceBase;
+        childFaces.reserve(4 * refined.size());
+        childFaceBase.reserve(4 * refined.size());
+        for (auto face: refined) {
+            for (int corner = 0; corner < 4; corner++) {
+                auto edge = Quad::faceEdge(face, corner);
+                if (edgeChild[edge] == -1) {
+                    auto opposite = level._edges[edge].opposite;
+                    edgeChild[edge] = edgeChild[opposite] = child._vertices.size();
+                    child._vertices.push_back({level.edgePoint(edge, facePoints.data()), {}});
+                    childGlobalIds.push_back(numGlobal++);
+                }
+            }
+            VertexID center = child._vertices.size();
+            child._vertices.push_back(facePoints[face]);
+            childGlobalIds.push_back(numGlobal++);
+
+            for (int corner = 0; corner < 4; corner++) {
+                auto edge = Quad::faceEdge(face, corner);
+                childFaces.push_back({vertexChild[level._edges[edge].vertex], edgeChild[edge], center,
+                                      edgeChild[Quad::prevEdge(edge)]});
+                childFaceBase.push_back(faceBase[face]);
+            }
+        }
+        child.addFaces(childFaces);
+
+        positions.resize(numGlobal);
+        normals.resize(numGlobal);
+        auto closed = computeLimits(child, childGlobalIds, firstNew);
+
+        // New points without a closed ring are edge points; their edge
+        // endpoints are start vertex of their half-edge in level mesh
+        for (size_t edge = 0; edge < level._edges.size(); edge++) {
+            auto point = edgeChild[edge];
+            if (point != -1 && !closed[point] && edge < size_t(level._edges[edge].opposite)) {
+                hanging.push_back({childGlobalIds[point],
+                                   globalIds[level._edges[edge].vertex],
+                                   globalIds[level._edges[Quad::nextEdge(edge)].vertex]});
+            }
+        }
+
+        level = move(child);
+        globalIds = move(childGlobalIds);
+        faceBase = move(childFaceBase);
+    }
+
+    for (auto &point: hanging) {
+        positions[point[0]] = (positions[point[1]] + positions[point[2]]) / 2.0f;
+        normals[point[0]] = (normals[point[1]] + normals[point[2]]).getNormalized();
+    }
+
+    // Keep only vertices used by output faces, in global ID order
+    vector<VertexID> outputIds(numGlobal, -1);
+    for (auto &face: outputFaces) {
+        for (auto v: face) {
+            outputIds[v] = 0;
+        }
+    }
+    Quad result;
+    for (VertexID v = 0; v < numGlobal; v++) {
+        if (outputIds[v] != -1) {
+            outputIds[v] = result._vertices.size();
+            result._vertices.push_back({positions[v], normals[v]});
+        }
+    }
+    for (auto &face: outputFaces) {
+        for (auto &v: face) {
+            v = outputIds[v];
+        }
+    }
+    result.addFaces(outputFaces);
+
+    parallelForBlocks(executor, result._faces.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto face = begin; face < end; face++) {
+            result._faces[face].normal = result.faceNormal(face);
+        }
+    });
+    result._normalsValid = true;
+    return result;
+}
+
+vector<int> AdaptiveSubdivision::extraordinaryLevels(const Quad &control, int level,
+                                                     int regularLevel)
+{
+    auto &edges = control._edges;
+    vector<int> levels(control._faces.size(), regularLevel);
+    for (size_t edge = 0; edge < edges.size(); edge++) {
+        int valence = 0;
+        auto e = EdgeID(edge);
+        do {
+            valence++;
+            e = control.nextOutgoing(e);
+        } while (e != -1 && e != EdgeID(edge));
+        if (e == -1 || valence != 4) {
+            levels[Quad::edgeFace(edge)] = level;
+        }
+    }
+    return levels;
+}
+
+vector<int> AdaptiveSubdivision::edgeLengthLevels(const Quad &control, float maxEdgeLength,
+                                                  int maxLevel)
+{
+    auto &edges = control._edges;
+    vector<int> levels(control._faces.size());
+    for (size_t face = 0; face < levels.size(); face++) {
+        float longest = 0.0f;
+        for (int corner = 0; corner < 4; corner++) {
+            auto edge = Quad::faceEdge(face, corner);
+            longest = max(longest, control._vertices[edges[edge].vertex].position.distance(
+                                       control._vertices[edges[Quad::nextEdge(edge)].vertex].position));
+        }
+        levels[face] = halvingLevels(longest / maxEdgeLength, maxLevel);
+    }
+    return levels;
+}
+
+vector<int> AdaptiveSubdivision::curvatureLevels(const Quad &control, float maxAngle, int maxLevel)
+{
+    auto &edges = control._edges;
+    vector<ofVec3f> faceNormals(control._faces.size());
+    for (size_t face = 0; face < faceNormals.size(); face++) {
+        faceNormals[face] = control.faceNormal(face);
+    }
+
+    vector<int> levels(control._faces.size());
+    for (size_t face = 0; face < levels.size(); face++) {
+        float largest = 0.0f;
+        for (int corner = 0; corner < 4; corner++) {
+            auto opposite = edges[Quad::faceEdge(face, corner)].opposite;
+            if (opposite != -1) {
+                largest = max(largest, faceNormals[face].angle(faceNormals[Quad::edgeFace(opposite)]));
+            }
+        }
+        levels[face] = halvingLevels(largest / maxAngle, maxLevel);
+    }
+    return levels;
+}
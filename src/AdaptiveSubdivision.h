@@ -0,0 +1,63 @@
+#ifndef OFXQUAD_ADAPTIVESUBDIVISION_H
+#define OFXQUAD_ADAPTIVESUBDIVISION_H
+
+#include "Quad.h"
+#include <vector>
+#include <functional>
+
+
+namespace ofx
+{
+
+class Executor;
+
+// Catmull-Clark subdivision where each face of control mesh is refined to
+// its own level. Faces that share a vertex are kept within one level of
+// each other, which is enough for every refined face to have the full
+// ring of faces it needs. Vertices of output mesh are moved onto limit
+// surface, so faces of different levels meet without cracks: where a
+// coarse face meets two finer ones, edge point between them lies on
+// straight edge of coarse face. Output doesn't pair half-edges across
+// those T-junctions, so it can't be subdivided further. Control mesh must
+// be closed, and must outlive AdaptiveSubdivision.
+class AdaptiveSubdivision
+{
+public:
+    // Target level for each face of control mesh. Throws
+    // std::invalid_argument if number of levels doesn't match number of
+    // faces, or control mesh isn't closed.
+    AdaptiveSubdivision(const Quad &control, const std::vector<int> &faceLevels);
+    AdaptiveSubdivision(const Quad &control, const std::function<int(FaceID)> &faceLevel);
+
+    // Levels after balancing; never lower than requested
+    const std::vector<int> &getFaceLevels() const;
+
+    // Subdivide control mesh, with limit positions and normals
+    Quad createQuad(Executor *executor=nullptr) const;
+
+    // Given level for faces that touch an extraordinary vertex (valence
+    // other than 4), regularLevel for all other faces
+    static std::vector<int> extraordinaryLevels(const Quad &control, int level,
+                                                int regularLevel=0);
+
+    // Lowest level at which no edge of face is longer than maxEdgeLength,
+    // assuming each level halves edge length, up to maxLevel
+    static std::vector<int> edgeLengthLevels(const Quad &control, float maxEdgeLength,
+                                             int maxLevel);
+
+    // Lowest level at which angle in degrees between normal of face and
+    // normals of its edge neighbors drops below maxAngle, assuming each
+    // level halves angle, up to maxLevel
+    static std::vector<int> curvatureLevels(const Quad &control, float maxAngle, int maxLevel);
+
+private:
+    const Quad &_control;
+    std::vector<int> _faceLevels;
+
+    void balanceLevels();
+};
+
+};
+
+
+#endif
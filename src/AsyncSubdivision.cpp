@@ -0,0 +1,252 @@
+#include "AsyncSubdivision.h"
+#include "Executor.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+
+
+namespace
+{
+
+// Thrown out of loop bodies once level being built is cancelled
+struct Cancelled
+{
+};
+
+// Runs loops on another executor, or on calling thread, and abandons them
+// between ranges once generation has moved on. Without another executor,
+// body is called once per index, which is once per block for
+// parallelForBlocks(), so serial loops stop about as quickly.
+class CancellableExecutor : public Executor
+{
+public:
+    CancellableExecutor(Executor *executor, const atomic<unsigned> &generation, unsigned expected)
+        : _executor(executor), _generation(generation), _expected(expected)
+    {
+
+    }
+
+    void parallelFor(size_t count, const RangeFunction &body)
+    {
+        if (_executor) {
+            _executor->parallelFor(count, [&](size_t begin, size_t end) {
+                check();
+                body(begin, end);
+            });
+        }
+        else {
+            for (size_t i = 0; i < count; i++) {
+                check();
+                body(i, i + 1);
+            }
+        }
+    }
+
+private:
+    Executor *_executor;
+    const atomic<unsigned> &_generation;
+    unsigned _expected;
+
+    void check() const
+    {
+        if (_generation != _expected) {
+            throw Cancelled();
+        }
+    }
+};
+
+};
+
+
+AsyncSubdivision::AsyncSubdivision(Quad base, int maxLevel, const SubdivideOptions &options)
+    : _options(options), _targetLevel(maxLevel), _builtLevel(0), _generation(0), _stop(false)
+{
+    if (maxLevel < 0) {
+        throw invalid_argument("subdivision level must not be negative");
+    }
+    base.calculateNormals(options.executor);
+    _levels.resize(maxLevel + 1);
+    _levels[0] = make_shared<const Quad>(move(base));
+    _drawBuffers.resize(maxLevel + 1);
+    _thread = thread(&AsyncSubdivision::run, this);
+}
+
+AsyncSubdivision::~AsyncSubdivision()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+        _generation++;
+    }
+    _wake.notify_one();
+    _thread.join();
+}
+
+int AsyncSubdivision::getMaxLevel() const
+{
+    return _levels.size() - 1;
+}
+
+// Levels are published in order, so every level up to built level is set
+int AsyncSubdivision::getPublishedLevel(int level) const
+{
+    return max(min(level, min(_targetLevel.load(), _builtLevel.load())), 0);
+}
+
+std::shared_ptr<const Quad> AsyncSubdivision::getLevel(int level) const
+{
+    return atomic_load(&_levels[getPublishedLevel(level)]);
+}
+
+std::shared_ptr<const Quad> AsyncSubdivision::getLatest() const
+{
+    return getLevel(getMaxLevel());
+}
+
+int AsyncSubdivision::getLatestLevel() const
+{
+    return min(_targetLevel.load(), _builtLevel.load());
+}
+
+int AsyncSubdivision::getTargetLevel() const
+{
+    return _targetLevel;
+}
+
+void AsyncSubdivision::setTargetLevel(int level)
+{
+    if (level < 0 || level > getMaxLevel()) {
+        throw out_of_range("subdivision level out of range");
+    }
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_builtLevel + 1 > level) {
+            _generation++;
+        }
+        _targetLevel = level;
+    }
+    _wake.notify_one();
+    _done.notify_all();
+}
+
+void AsyncSubdivision::cancel()
+{
+    setTargetLevel(min(_targetLevel.load(), _builtLevel.load()));
+}
+
+bool AsyncSubdivision::isDone() const
+{
+    return _builtLevel >= _targetLevel;
+}
+
+void AsyncSubdivision::wait()
+{
+    unique_lock<mutex> lock(_mutex);
+    _done.wait(lock, [this] { return _builtLevel >= _targetLevel || _error; });
+    if (_error) {
+        auto error = _error;
+        _error = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+// Build next level while target is above built level. Result of a level
+// that was cancelled while being built is thrown away.
+void AsyncSubdivision::run()
+{
+    unique_lock<mutex> lock(_mutex);
+    while (true) {
+        _wake.wait(lock, [this] { return _stop || _builtLevel < _targetLevel; });
+        if (_stop) {
+            return;
+        }
+        int level = _builtLevel + 1;
+        unsigned generation = _generation;
+        lock.unlock();
+
+        shared_ptr<const Quad> quad;
+        exception_ptr error;
+        try {
+            CancellableExecutor executor(_options.executor, _generation, generation);
+            auto options = _options;
+            options.executor = &executor;
+            Quad subdivided;
+            if (options.limitSurface) {
+                subdivided = _levels[0]->subdivide(level, options);
+            }
+            else {
+                subdivided = _levels[level - 1]->subdivide(1, options);
+                subdivided.calculateNormals(&executor);
+            }
+            quad = make_shared<const Quad>(move(subdivided));
+        }
+        catch (const Cancelled &) {
+        }
+        catch (...) {
+            error = current_exception();
+        }
+
+        lock.lock();
+        if (error) {
+            _error = error;
+            _targetLevel = int(_builtLevel);
+        }
+        else if (quad && generation == _generation) {
+            atomic_store(&_levels[level], quad);
+            _builtLevel = level;
+        }
+        _done.notify_all();
+    }
+}
+
+// Buffers of a level are rebuilt only when a different mesh has been
+// published for it, or shading changed
+void AsyncSubdivision::draw(int level, bool smoothShading)
+{
+    level = getPublishedLevel(level);
+    auto quad = atomic_load(&_levels[level]);
+    auto &buffers = _drawBuffers[level];
+    if (buffers.meshQuad != quad || buffers.smoothShading != smoothShading) {
+        size_t numVertices, numIndices;
+        quad->getRenderBufferSize(smoothShading, numVertices, numIndices);
+        vector<ofVec3f> positions(numVertices);
+        vector<ofVec3f> normals(numVertices);
+        vector<ofIndexType> indices(numIndices);
+        quad->fillRenderBuffer(smoothShading, positions.data(), normals.data(), indices.data());
+
+        buffers.mesh.setVertexData(positions.data(), numVertices, GL_STATIC_DRAW);
+        buffers.mesh.setNormalData(normals.data(), numVertices, GL_STATIC_DRAW);
+        buffers.mesh.setIndexData(indices.data(), numIndices, GL_STATIC_DRAW);
+        buffers.numIndices = numIndices;
+        buffers.smoothShading = smoothShading;
+        buffers.meshQuad = quad;
+    }
+    if (buffers.numIndices > 0) {
+        buffers.mesh.drawElements(GL_TRIANGLES, buffers.numIndices);
+    }
+}
+
+void AsyncSubdivision::drawWireframe(int level)
+{
+    level = getPublishedLevel(level);
+    auto quad = atomic_load(&_levels[level]);
+    auto &buffers = _drawBuffers[level];
+    if (buffers.wireframeQuad != quad) {
+        vector<ofVec3f> positions(quad->getNumVertices());
+        for (size_t v = 0; v < positions.size(); v++) {
+            positions[v] = quad->getVertex(v);
+        }
+        vector<ofIndexType> indices(quad->getWireframeIndexCount());
+        quad->fillWireframeIndices(indices.data());
+
+        buffers.wireframe.setVertexData(positions.data(), positions.size(), GL_STATIC_DRAW);
+        buffers.wireframe.setIndexData(indices.data(), indices.size(), GL_STATIC_DRAW);
+        buffers.numWireframeIndices = indices.size();
+        buffers.wireframeQuad = quad;
+    }
+    if (buffers.numWireframeIndices > 0) {
+        buffers.wireframe.drawElements(GL_LINES, buffers.numWireframeIndices);
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef OFXQUAD_ASYNCSUBDIVISION_H
+#define OFXQUAD_ASYNCSUBDIVISION_H
+
+#include "Quad.h"
+#include <vector>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+
+namespace ofx
+{
+
+// Subdivides a base mesh on a background thread, one level at a time, and
+// publishes each level as soon as it is finished, so a render thread can
+// draw level N while level N + 1 is built. Published levels are swapped in
+// with atomic shared_ptr stores, so getting the latest level never waits
+// for subdivision.
+//
+// Levels have normals calculated before they are published, and are
+// never changed afterwards: they are shared as const meshes, which the
+// background thread keeps reading to build next level. Draw buffers are
+// kept apart from them, by draw() and drawWireframe() on render thread.
+class AsyncSubdivision
+{
+public:
+    // Start building levels 1 to maxLevel of base mesh, which can be moved
+    // in. Loops of each level run on options.executor, or on background
+    // thread if it is null; executor must outlive AsyncSubdivision. With
+    // options.limitSurface, each level is built from base mesh. Throws
+    // std::invalid_argument if maxLevel is negative.
+    AsyncSubdivision(Quad base, int maxLevel,
+                     const SubdivideOptions &options=SubdivideOptions());
+
+    // Cancels work in progress and waits for background thread to stop
+    ~AsyncSubdivision();
+
+    AsyncSubdivision(const AsyncSubdivision &) = delete;
+    AsyncSubdivision &operator=(const AsyncSubdivision &) = delete;
+
+    int getMaxLevel() const;
+
+    // Finest published level at or below given level, and at or below
+    // target level. Never null; base mesh is published from the start.
+    std::shared_ptr<const Quad> getLevel(int level) const;
+    std::shared_ptr<const Quad> getLatest() const;
+    int getLatestLevel() const;
+
+    int getTargetLevel() const;
+
+    // Build levels up to given level. Lowering target cancels level being
+    // built if it is above new target; published levels are kept, so
+    // raising target again only builds levels that are missing. Throws
+    // std::out_of_range for levels outside 0 to maxLevel.
+    void setTargetLevel(int level);
+
+    // Stop at levels published so far; same as lowering target to latest
+    // level
+    void cancel();
+
+    // Target level is published, or building it failed
+    bool isDone() const;
+
+    // Block until isDone(). Rethrows exception thrown while building a
+    // level, after which target is lowered to last published level.
+    void wait();
+
+    // Draw getLevel(level). Draw buffers are built on first draw of each
+    // published level and shading, and kept with the level. Must only be
+    // called from one thread.
+    void draw(int level, bool smoothShading=true);
+    void drawWireframe(int level);
+
+private:
+    // Published levels; slots are only written by background thread, and
+    // are read by other threads with std::atomic_load
+    std::vector<std::shared_ptr<const Quad>> _levels;
+    SubdivideOptions _options;
+
+    // Draw buffers of each level, only used by drawing thread
+    struct DrawBuffers
+    {
+        DrawBuffers() : numIndices(0), smoothShading(true), numWireframeIndices(0) {}
+
+        // Level that mesh and wireframe buffers were built from
+        std::shared_ptr<const Quad> meshQuad;
+        std::shared_ptr<const Quad> wireframeQuad;
+
+        ofVbo mesh;
+        std::size_t numIndices;
+        // Shading that mesh buffer was built for
+        bool smoothShading;
+
+        ofVbo wireframe;
+        std::size_t numWireframeIndices;
+    };
+    std::vector<DrawBuffers> _drawBuffers;
+
+    std::atomic<int> _targetLevel;
+    // All levels up to this one are published
+    std::atomic<int> _builtLevel;
+    // Incremented to cancel level being built
+    std::atomic<unsigned> _generation;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    bool _stop;
+    std::exception_ptr _error;
+
+    std::thread _thread;
+
+    // Index of level returned by getLevel()
+    int getPublishedLevel(int level) const;
+
+    void run();
+};
+
+};
+
+
+#endif
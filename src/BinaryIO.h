@@ -0,0 +1,76 @@
+#ifndef OFXQUAD_BINARYIO_H
+#define OFXQUAD_BINARYIO_H
+
+#include <cstdint>
+#include <cstring>
+
+
+namespace ofx
+{
+
+// Little-endian values at unaligned addresses, shared by the binary file
+// formats. Internal to the addon.
+namespace binary
+{
+
+inline bool isLittleEndian()
+{
+    const uint32_t one = 1;
+    char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+inline uint32_t swapBytes(uint32_t value)
+{
+    return (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+}
+
+inline uint64_t swapBytes(uint64_t value)
+{
+    return (uint64_t(swapBytes(uint32_t(value))) << 32) | swapBytes(uint32_t(value >> 32));
+}
+
+inline int32_t swapBytes(int32_t value)
+{
+    return int32_t(swapBytes(uint32_t(value)));
+}
+
+template<typename T>
+T readLittle(const char *p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return isLittleEndian() ? value : swapBytes(value);
+}
+
+template<typename T>
+void writeLittle(char *p, T value)
+{
+    if (!isLittleEndian()) {
+        value = swapBytes(value);
+    }
+    std::memcpy(p, &value, sizeof(T));
+}
+
+inline void writeFloat(char *p, float value)
+{
+    uint32_t word;
+    std::memcpy(&word, &value, 4);
+    writeLittle(p, word);
+}
+
+inline float readFloat(const char *p)
+{
+    auto word = readLittle<uint32_t>(p);
+    float value;
+    std::memcpy(&value, &word, 4);
+    return value;
+}
+
+};
+
+};
+
+
+#endif
@@ -0,0 +1,153 @@
+#include "Executor.h"
+#include <algorithm>
+
+using namespace std;
+using namespace ofx;
+
+namespace
+{
+
+// Set on threads running loop bodies so nested loops don't wait on
+// themselves
+thread_local bool insideLoop = false;
+
+}
+
+void SerialExecutor::parallelFor(size_t count, const RangeFunction &body)
+{
+    if (count > 0) {
+        body(0, count);
+    }
+}
+
+ThreadPoolExecutor::ThreadPoolExecutor(unsigned numThreads)
+    : _stop(false), _generation(0), _body(nullptr), _count(0), _grainSize(1),
+      _nextIndex(0), _busyWorkers(0)
+{
+    if (numThreads == 0) {
+        numThreads = max(1u, thread::hardware_concurrency());
+    }
+
+    // Calling thread is one of the threads doing work
+    for (unsigned i = 1; i < numThreads; i++) {
+        _workers.emplace_back(&ThreadPoolExecutor::workerLoop, this);
+    }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto &worker: _workers) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPoolExecutor::getNumThreads() const
+{
+    return _workers.size() + 1;
+}
+
+void ThreadPoolExecutor::parallelFor(size_t count, const RangeFunction &body)
+{
+    if (count == 0) {
+        return;
+    }
+    if (_workers.empty() || insideLoop) {
+        body(0, count);
+        return;
+    }
+
+    lock_guard<mutex> loopLock(_loopMutex);
+    {
+        lock_guard<mutex> lock(_mutex);
+        _body = &body;
+        _count = count;
+        // Several ranges per thread so uneven ranges balance out
+        _grainSize = max<size_t>(1, count / (getNumThreads() * 8));
+        _nextIndex = 0;
+        _error = nullptr;
+        _busyWorkers = _workers.size();
+        _generation++;
+    }
+    _wake.notify_all();
+
+    insideLoop = true;
+    runRanges();
+    insideLoop = false;
+
+    unique_lock<mutex> lock(_mutex);
+    _done.wait(lock, [this] { return _busyWorkers == 0; });
+    _body = nullptr;
+    if (_error) {
+        auto error = _error;
+        _error = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+void ThreadPoolExecutor::workerLoop()
+{
+    insideLoop = true;
+    unsigned generation = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(_mutex);
+            _wake.wait(lock, [this, generation] { return _stop || _generation != generation; });
+            if (_stop) {
+                return;
+            }
+            generation = _generation;
+        }
+
+        runRanges();
+
+        lock_guard<mutex> lock(_mutex);
+        if (--_busyWorkers == 0) {
+            _done.notify_one();
+        }
+    }
+}
+
+// Grab ranges of current loop until none are left
+void ThreadPoolExecutor::runRanges()
+{
+    while (true) {
+        auto begin = _nextIndex.fetch_add(_grainSize);
+        if (begin >= _count) {
+            return;
+        }
+        auto end = min(begin + _grainSize, _count);
+        try {
+            (*_body)(begin, end);
+        }
+        catch (...) {
+            lock_guard<mutex> lock(_mutex);
+            if (!_error) {
+                _error = current_exception();
+            }
+            // Skip remaining ranges
+            _nextIndex = _count;
+        }
+    }
+}
+
+void ofx::parallelForBlocks(Executor *executor, size_t count, size_t blockSize,
+                            const RangeFunction &body)
+{
+    auto numBlocks = (count + blockSize - 1) / blockSize;
+    auto blockBody = [&](size_t beginBlock, size_t endBlock) {
+        for (auto block = beginBlock; block < endBlock; block++) {
+            body(block * blockSize, min((block + 1) * blockSize, count));
+        }
+    };
+    if (executor) {
+        executor->parallelFor(numBlocks, blockBody);
+    }
+    else {
+        blockBody(0, numBlocks);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef OFXQUAD_EXECUTOR_H
+#define OFXQUAD_EXECUTOR_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+
+namespace ofx
+{
+
+// Loop body called for index range [begin, end)
+typedef std::function<void(std::size_t begin, std::size_t end)> RangeFunction;
+
+// Runs loops over index ranges. Implementations decide how ranges are
+// split up and where they run; callers must only write to outputs owned by
+// the indices in range, so results never depend on scheduling.
+class Executor
+{
+public:
+    virtual ~Executor() {}
+
+    // Call body over ranges that together cover [0, count) exactly once.
+    // Returns after all calls have finished. If a call throws, first
+    // exception is rethrown on calling thread.
+    virtual void parallelFor(std::size_t count, const RangeFunction &body) = 0;
+};
+
+// Runs whole loop on calling thread
+class SerialExecutor : public Executor
+{
+public:
+    void parallelFor(std::size_t count, const RangeFunction &body);
+};
+
+// Fixed pool of worker threads. Calling thread helps out while waiting for
+// loop to finish. Loops started from inside a loop body run serially.
+class ThreadPoolExecutor : public Executor
+{
+public:
+    // Zero threads means one per hardware thread
+    explicit ThreadPoolExecutor(unsigned numThreads=0);
+    ~ThreadPoolExecutor();
+
+    ThreadPoolExecutor(const ThreadPoolExecutor &) = delete;
+    ThreadPoolExecutor &operator=(const ThreadPoolExecutor &) = delete;
+
+    unsigned getNumThreads() const;
+
+    void parallelFor(std::size_t count, const RangeFunction &body);
+
+private:
+    std::vector<std::thread> _workers;
+
+    // Only one loop runs on pool at a time
+    std::mutex _loopMutex;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    bool _stop;
+    unsigned _generation;
+
+    // Current loop; valid while _busyWorkers > 0 or loop is running
+    const RangeFunction *_body;
+    std::size_t _count;
+    std::size_t _grainSize;
+    std::atomic<std::size_t> _nextIndex;
+    unsigned _busyWorkers;
+    std::exception_ptr _error;
+
+    void workerLoop();
+    void runRanges();
+};
+
+// Split [0, count) into contiguous blocks of blockSize and call body once
+// per block. Block boundaries depend only on count and blockSize.
+void parallelForBlocks(Executor *executor, std::size_t count, std::size_t blockSize,
+                       const RangeFunction &body);
+
+};
+
+
+#endif
@@ -0,0 +1,65 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define OFXQUAD_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace ofx;
+
+
+MappedFile::MappedFile(const string &path) : _data(nullptr), _size(0), _mapped(false)
+{
+#ifdef OFXQUAD_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw runtime_error("Could not open file: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        auto address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            madvise(address, info.st_size, MADV_SEQUENTIAL);
+            _data = static_cast<const char *>(address);
+            _size = info.st_size;
+            _mapped = true;
+        }
+    }
+    close(fd);
+    if (_mapped) {
+        return;
+    }
+#endif
+
+    // Mapping not supported or failed; read whole file instead
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw runtime_error("Could not open file: " + path);
+    }
+    input.seekg(0, ios::end);
+    auto size = input.tellg();
+    input.seekg(0, ios::beg);
+    if (size > 0) {
+        _buffer.resize(size_t(size));
+        if (!input.read(_buffer.data(), size)) {
+            throw runtime_error("Could not read file: " + path);
+        }
+    }
+    _data = _buffer.data();
+    _size = _buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef OFXQUAD_MMAP
+    if (_mapped) {
+        munmap(const_cast<char *>(_data), _size);
+    }
+#endif
+}
@@ -0,0 +1,41 @@
+#ifndef OFXQUAD_MAPPEDFILE_H
+#define OFXQUAD_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace ofx
+{
+
+// Read-only view of whole file. File is memory mapped where supported,
+// otherwise read into memory. Throws std::runtime_error if file can't be
+// opened.
+class MappedFile
+{
+public:
+    MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+private:
+    const char *_data;
+    std::size_t _size;
+
+    // True if _data points into a mapping that must be unmapped
+    bool _mapped;
+
+    // Contents when file couldn't be mapped
+    std::vector<char> _buffer;
+};
+
+};
+
+
+#endif
@@ -0,0 +1,108 @@
+#include "NormalEngine.h"
+#include "Executor.h"
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+using namespace ofx;
+
+
+NormalEngine::NormalEngine(const Quad &quad)
+    : _vertexEdges(quad._vertices.size(), -1), _numFaces(quad._faces.size()),
+      _faceMarks(_numFaces, 0), _vertexMarks(quad._vertices.size(), 0), _mark(0)
+{
+    for (size_t edge = 0; edge < quad._edges.size(); edge++) {
+        if (quad.ownsVertex(edge)) {
+            _vertexEdges[quad._edges[edge].vertex] = edge;
+        }
+    }
+}
+
+void NormalEngine::checkTopology(const Quad &quad) const
+{
+    if (quad._vertices.size() != _vertexEdges.size() || quad._faces.size() != _numFaces) {
+        throw invalid_argument("mesh does not match normal engine");
+    }
+}
+
+void NormalEngine::update(Quad &quad, Executor *executor) const
+{
+    checkTopology(quad);
+    quad.calculateNormals(executor);
+}
+
+void NormalEngine::update(Quad &quad, const vector<VertexID> &modifiedVertices,
+                          Executor *executor)
+{
+    const size_t blockSize = 1024;
+    checkTopology(quad);
+
+    // Marks are compared against a counter so that they never need to be
+    // cleared, except when counter wraps around
+    if (++_mark == 0) {
+        fill(_faceMarks.begin(), _faceMarks.end(), 0);
+        fill(_vertexMarks.begin(), _vertexMarks.end(), 0);
+        _mark = 1;
+    }
+
+    // Faces around modified vertices
+    _faces.clear();
+    _vertices.clear();
+    for (auto v: modifiedVertices) {
+        if (v < 0 || size_t(v) >= _vertexEdges.size()) {
+            throw invalid_argument("modified vertex does not exist");
+        }
+        auto edge = _vertexEdges[v];
+        if (edge == -1) {
+            if (_vertexMarks[v] != _mark) {
+                _vertexMarks[v] = _mark;
+                _vertices.push_back(v);
+            }
+            continue;
+        }
+        auto addFace = [&](EdgeID e) {
+            auto face = Quad::edgeFace(e);
+            if (_faceMarks[face] != _mark) {
+                _faceMarks[face] = _mark;
+                _faces.push_back(face);
+            }
+        };
+        auto e = edge;
+        do {
+            addFace(e);
+            e = quad.nextOutgoing(e);
+        } while (e != -1 && e != edge);
+        if (e == -1) {
+            for (e = quad.prevOutgoing(edge); e != -1; e = quad.prevOutgoing(e)) {
+                addFace(e);
+            }
+        }
+    }
+
+    // Vertices whose smooth normal depends on those faces
+    for (auto face: _faces) {
+        for (int corner = 0; corner < 4; corner++) {
+            auto v = quad._edges[Quad::faceEdge(face, corner)].vertex;
+            if (_vertexMarks[v] != _mark) {
+                _vertexMarks[v] = _mark;
+                _vertices.push_back(v);
+            }
+        }
+    }
+
+    parallelForBlocks(executor, _faces.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            quad._faces[_faces[i]].normal = quad.faceNormal(_faces[i]);
+        }
+    });
+    parallelForBlocks(executor, _vertices.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto v = _vertices[i];
+            if (_vertexEdges[v] != -1) {
+                quad._vertices[v].normal = quad.vertexNormal(_vertexEdges[v]);
+            }
+        }
+    });
+
+    quad._normalsValid = true;
+}
@@ -0,0 +1,57 @@
+#ifndef OFXQUAD_NORMALENGINE_H
+#define OFXQUAD_NORMALENGINE_H
+
+#include "Quad.h"
+#include <vector>
+#include <cstdint>
+
+
+namespace ofx
+{
+
+class Executor;
+
+// Normal updates for a mesh whose topology stays fixed. Engine is built
+// once from mesh topology; afterwards, moving some vertices only requires
+// recalculating normals of faces around them and of vertices of those
+// faces. Results are identical to Quad::calculateNormals().
+class NormalEngine
+{
+public:
+    NormalEngine(const Quad &quad);
+
+    // Recalculate all normals
+    void update(Quad &quad, Executor *executor=nullptr) const;
+
+    // Recalculate normals affected by moving given vertices. Normals of
+    // mesh must otherwise be up to date. Throws std::invalid_argument if
+    // quad doesn't match topology engine was built from.
+    void update(Quad &quad, const std::vector<VertexID> &modifiedVertices,
+                Executor *executor=nullptr);
+
+    // Faces and vertices whose normals were recalculated by last
+    // incremental update. Modified vertices without faces are included in
+    // vertices, though their normal doesn't change.
+    const std::vector<FaceID> &getUpdatedFaces() const { return _faces; }
+    const std::vector<VertexID> &getUpdatedVertices() const { return _vertices; }
+
+private:
+    // Half-edge owning each vertex, or -1 for vertices without faces
+    std::vector<EdgeID> _vertexEdges;
+    std::size_t _numFaces;
+
+    // Marks for collecting each face and vertex once per update
+    std::vector<uint32_t> _faceMarks;
+    std::vector<uint32_t> _vertexMarks;
+    uint32_t _mark;
+
+    std::vector<FaceID> _faces;
+    std::vector<VertexID> _vertices;
+
+    void checkTopology(const Quad &quad) const;
+};
+
+};
+
+
+#endif
@@ -0,0 +1,250 @@
+#include "ObjReader.h"
+#include "Executor.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+using namespace std;
+using namespace ofx;
+
+
+namespace
+{
+
+// Bytes of OBJ data parsed per chunk when parsing in parallel
+const size_t chunkSize = 1 << 22;
+
+// Vertices and faces of one chunk of OBJ data
+struct ObjChunk
+{
+    vector<ofVec3f> vertices;
+    vector<array<VertexID, 4>> faces;
+
+    // Bit i is set if index i of face was negative in file. Such indices
+    // are stored relative to first vertex of chunk and fixed up once
+    // vertex counts of earlier chunks are known.
+    vector<uint8_t> relative;
+};
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char *skipSpaces(const char *p, const char *end)
+{
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+inline const char *skipToken(const char *p, const char *end)
+{
+    while (p < end && !isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+float parseFloat(const char *begin, const char *end)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    if (begin < end && *begin == '+') {
+        begin++;
+    }
+    float value;
+    auto result = from_chars(begin, end, value);
+    if (result.ec != errc() || result.ptr != end) {
+        throw runtime_error("Invalid number in OBJ file: " + string(begin, end));
+    }
+    return value;
+#else
+    // strtof needs a terminated string, and mapped file isn't terminated
+    char buffer[64];
+    size_t length = end - begin;
+    if (length == 0 || length >= sizeof(buffer)) {
+        throw runtime_error("Invalid number in OBJ file: " + string(begin, end));
+    }
+    memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+    char *stop;
+    float value = strtof(buffer, &stop);
+    if (stop != buffer + length) {
+        throw runtime_error("Invalid number in OBJ file: " + string(begin, end));
+    }
+    return value;
+#endif
+}
+
+// Parse vertex index at start of face token, ignoring any "/vt/vn" part
+int parseIndex(const char *begin, const char *end)
+{
+    auto p = begin;
+    bool negative = p < end && *p == '-';
+    if (negative) {
+        p++;
+    }
+    int64_t value = 0;
+    auto digits = p;
+    while (p < end && *p >= '0' && *p <= '9' && value <= INT32_MAX) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    if (p == digits || value == 0 || value > INT32_MAX || (p < end && *p != '/')) {
+        throw runtime_error("Invalid face index in OBJ file: " + string(begin, end));
+    }
+    return negative ? -int(value) : int(value);
+}
+
+void parseVertex(const char *p, const char *end, ObjChunk &chunk)
+{
+    float coordinates[3];
+    for (int i = 0; i < 3; i++) {
+        p = skipSpaces(p, end);
+        auto tokenEnd = skipToken(p, end);
+        if (p == tokenEnd) {
+            throw runtime_error("Vertex in OBJ file needs 3 coordinates");
+        }
+        coordinates[i] = parseFloat(p, tokenEnd);
+        p = tokenEnd;
+    }
+    chunk.vertices.push_back({coordinates[0], coordinates[1], coordinates[2]});
+}
+
+void parseFace(const char *p, const char *end, ObjChunk &chunk)
+{
+    array<VertexID, 4> face;
+    uint8_t relative = 0;
+    int numVertices = 0;
+    while (true) {
+        p = skipSpaces(p, end);
+        if (p == end) {
+            break;
+        }
+        auto tokenEnd = skipToken(p, end);
+        if (numVertices == 4) {
+            throw runtime_error("Only faces with 4 vertices are supported in OBJ file");
+        }
+        auto index = parseIndex(p, tokenEnd);
+        if (index > 0) {
+            face[numVertices] = index - 1;
+        }
+        else {
+            face[numVertices] = VertexID(chunk.vertices.size()) + index;
+            relative |= 1 << numVertices;
+        }
+        numVertices++;
+        p = tokenEnd;
+    }
+    if (numVertices != 4) {
+        throw runtime_error("Only faces with 4 vertices are supported in OBJ file");
+    }
+    chunk.faces.push_back(face);
+    chunk.relative.push_back(relative);
+}
+
+void parseChunk(const char *p, const char *end, ObjChunk &chunk)
+{
+    while (p < end) {
+        auto lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        p = skipSpaces(p, lineEnd);
+        if (lineEnd - p >= 2 && (p[1] == ' ' || p[1] == '\t')) {
+            if (p[0] == 'v') {
+                parseVertex(p + 2, lineEnd, chunk);
+            }
+            else if (p[0] == 'f') {
+                parseFace(p + 2, lineEnd, chunk);
+            }
+        }
+        p = lineEnd + 1;
+    }
+}
+
+// Start of each chunk, plus end of data. Chunks start right after a line
+// break so that no line is split.
+vector<const char *> chunkBoundaries(const char *data, size_t size)
+{
+    vector<const char *> boundaries = {data};
+    auto end = data + size;
+    auto p = data;
+    while (size_t(end - p) > chunkSize) {
+        p = static_cast<const char *>(memchr(p + chunkSize, '\n', end - p - chunkSize));
+        if (!p) {
+            break;
+        }
+        p++;
+        boundaries.push_back(p);
+    }
+    boundaries.push_back(end);
+    return boundaries;
+}
+
+};
+
+
+ObjMesh ofx::parseObj(const char *data, size_t size, Executor *executor)
+{
+    vector<const char *> boundaries = {data, data + size};
+    if (executor) {
+        boundaries = chunkBoundaries(data, size);
+    }
+    auto numChunks = boundaries.size() - 1;
+
+    vector<ObjChunk> chunks(numChunks);
+    parallelForBlocks(executor, numChunks, 1, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            parseChunk(boundaries[i], boundaries[i + 1], chunks[i]);
+        }
+    });
+
+    // Offsets of each chunk's vertices and faces in joined arrays
+    vector<size_t> firstVertex(numChunks + 1, 0);
+    vector<size_t> firstFace(numChunks + 1, 0);
+    for (size_t i = 0; i < numChunks; i++) {
+        firstVertex[i + 1] = firstVertex[i] + chunks[i].vertices.size();
+        firstFace[i + 1] = firstFace[i] + chunks[i].faces.size();
+    }
+    auto numVertices = firstVertex[numChunks];
+
+    ObjMesh mesh;
+    mesh.vertices.resize(numVertices);
+    mesh.faces.resize(firstFace[numChunks]);
+    parallelForBlocks(executor, numChunks, 1, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto &chunk = chunks[i];
+            copy(chunk.vertices.begin(), chunk.vertices.end(), mesh.vertices.begin() + firstVertex[i]);
+            for (size_t f = 0; f < chunk.faces.size(); f++) {
+                auto face = chunk.faces[f];
+                for (int k = 0; k < 4; k++) {
+                    if (chunk.relative[f] & (1 << k)) {
+                        face[k] += firstVertex[i];
+                    }
+                    if (face[k] < 0 || size_t(face[k]) >= numVertices) {
+                        throw runtime_error("Face in OBJ file refers to missing vertex");
+                    }
+                }
+                mesh.faces[firstFace[i] + f] = face;
+            }
+            vector<ofVec3f>().swap(chunk.vertices);
+        }
+    });
+    return mesh;
+}
+
+ObjMesh ofx::readObj(const string &path, Executor *executor)
+{
+    MappedFile file(path);
+    return parseObj(file.data(), file.size(), executor);
+}
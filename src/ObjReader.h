@@ -0,0 +1,41 @@
+#ifndef OFXQUAD_OBJREADER_H
+#define OFXQUAD_OBJREADER_H
+
+#include "Quad.h"
+#include <vector>
+#include <array>
+#include <string>
+#include <cstddef>
+
+
+namespace ofx
+{
+
+class Executor;
+
+// Vertices and quad faces of OBJ file. Face vertex IDs index vertices,
+// starting from 0.
+struct ObjMesh
+{
+    std::vector<ofVec3f> vertices;
+    std::vector<std::array<VertexID, 4>> faces;
+};
+
+// Parse OBJ data. Only "v" and "f" lines are used; other lines are
+// skipped. Face tokens may be "v", "v/vt", "v//vn" or "v/vt/vn", and
+// negative (relative) indices are allowed. Throws std::runtime_error on
+// malformed numbers, faces that aren't quads and indices outside vertex
+// list.
+//
+// With an executor, data is split into chunks at line boundaries that are
+// parsed in parallel and then joined in file order, so result doesn't
+// depend on executor.
+ObjMesh parseObj(const char *data, std::size_t size, Executor *executor=nullptr);
+
+// Memory map OBJ file and parse it with parseObj()
+ObjMesh readObj(const std::string &path, Executor *executor=nullptr);
+
+};
+
+
+#endif
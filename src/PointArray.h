@@ -0,0 +1,92 @@
+#ifndef OFXQUAD_POINTARRAY_H
+#define OFXQUAD_POINTARRAY_H
+
+#include "ofMain.h"
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+
+namespace ofx
+{
+
+// Allocator returning memory aligned for vector loads
+template<typename T, std::size_t Alignment>
+class AlignedAllocator
+{
+public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T *allocate(std::size_t n)
+    {
+        // Over-allocate and store offset to original pointer right before
+        // aligned block
+        auto raw = static_cast<char *>(std::malloc(n * sizeof(T) + Alignment + sizeof(void *)));
+        if (!raw) {
+            throw std::bad_alloc();
+        }
+        auto address = reinterpret_cast<std::size_t>(raw + sizeof(void *));
+        auto aligned = reinterpret_cast<char *>((address + Alignment - 1) & ~(Alignment - 1));
+        reinterpret_cast<void **>(aligned)[-1] = raw;
+        return reinterpret_cast<T *>(aligned);
+    }
+
+    void deallocate(T *p, std::size_t)
+    {
+        std::free(reinterpret_cast<void **>(p)[-1]);
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+};
+
+typedef std::vector<float, AlignedAllocator<float, 32>> AlignedFloats;
+
+// Structure-of-arrays storage of 3D points: separate x, y and z arrays so
+// that kernels can load several points per instruction
+struct PointArray
+{
+    AlignedFloats x;
+    AlignedFloats y;
+    AlignedFloats z;
+
+    std::size_t size() const { return x.size(); }
+
+    void resize(std::size_t n)
+    {
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+    }
+
+    void set(std::size_t i, const ofVec3f &p)
+    {
+        x[i] = p.x;
+        y[i] = p.y;
+        z[i] = p.z;
+    }
+
+    ofVec3f get(std::size_t i) const
+    {
+        return {x[i], y[i], z[i]};
+    }
+};
+
+};
+
+
+#endif
@@ -1,10 +1,15 @@
 #include "Quad.h"
+#include "Executor.h"
+#include "PointArray.h"
+#include "ObjReader.h"
 #include <memory>
 #include <cassert>
 #include <iostream>
 #include "ofVboMesh.h"
 #include <exception>
-#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 using namespace std;
 using namespace ofx;
@@ -26,43 +31,112 @@ EdgeKey makeEdgeKey(VertexID v0, VertexID v1)
     return {v0, v1};
 }
 
-Quad::Quad() : _redrawMesh(true)
+// Spread low 21 bits of value so there are two zero bits between each
+uint64_t spreadBits(uint64_t value)
 {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffULL;
+    value = (value | value << 16) & 0x1f0000ff0000ffULL;
+    value = (value | value << 8) & 0x100f00f00f00f00fULL;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+    value = (value | value << 2) & 0x1249249249249249ULL;
+    return value;
+}
 
+// Morton code of point quantized to 21 bits per axis within box
+uint64_t mortonCode(ofVec3f point, ofVec3f boxMin, ofVec3f boxSize)
+{
+    uint64_t code = 0;
+    for (int i = 0; i < 3; i++) {
+        float t = boxSize[i] > 0.0f ? (point[i] - boxMin[i]) / boxSize[i] : 0.0f;
+        auto quantized = uint64_t(min(max(t, 0.0f), 1.0f) * 0x1fffff);
+        code |= spreadBits(quantized) << i;
+    }
+    return code;
 }
 
-Quad::Quad(string objFilename) : _redrawMesh(true)
+// Move width values of each element i to element oldToNew[i]. Values are
+// copied back so array keeps its capacity.
+void scatterValues(vector<float> &values, size_t width, const vector<int32_t> &oldToNew)
 {
-    load(objFilename);
+    vector<float> moved(values.size());
+    for (size_t i = 0; i < oldToNew.size(); i++) {
+        copy_n(&values[width * i], width, &moved[width * oldToNew[i]]);
+    }
+    copy(moved.begin(), moved.end(), values.begin());
 }
 
-// Load mesh data from OBJ file.
-// Mesh in OBJ file is restricted to 4 sided polygons.
-void Quad::load(std::string objFilename)
+// Whether growing array to given size reallocates it. Used for counting
+// allocations.
+template <typename T>
+bool reallocates(const vector<T> &array, size_t size)
 {
-    ifstream input("./bin/" + objFilename);
+    return size > array.capacity();
+}
 
-    vector<VertexID> vertexIDs;
+// Upload given render vertices of mesh that has already been drawn, and
+// clear its changed flags so that ofVboMesh doesn't upload whole arrays
+// again on next draw. Vertices are uploaded in runs of nearby entries;
+// small gaps are uploaded too, to save calls.
+void uploadVertices(ofVboMesh &mesh, vector<size_t> &vertices, bool hasNormals)
+{
+    const size_t maxGap = 64;
 
-    string line;
-    vector<string> tokens;
-    while (getline(input, line)) {
-        tokens.clear();
-        boost::split(tokens, line, boost::is_any_of(" "));
-        if (tokens.size() == 4 && tokens[0] == "v") {
-            auto vID = addVertex({stof(tokens[1]), stof(tokens[2]), stof(tokens[3])});
-            vertexIDs.push_back(vID);
+    auto &vbo = mesh.getVbo();
+    sort(vertices.begin(), vertices.end());
+    for (size_t i = 0; i < vertices.size();) {
+        auto begin = vertices[i];
+        auto end = begin + 1;
+        for (i++; i < vertices.size() && vertices[i] <= end + maxGap; i++) {
+            end = vertices[i] + 1;
         }
-        else if (tokens.size() == 5 && tokens[0] == "f") {
-            auto v0 = vertexIDs[stoi(tokens[1]) - 1];
-            auto v1 = vertexIDs[stoi(tokens[2]) - 1];
-            auto v2 = vertexIDs[stoi(tokens[3]) - 1];
-            auto v3 = vertexIDs[stoi(tokens[4]) - 1];
-            addFace(v0, v1, v2, v3);
+        auto offset = begin * sizeof(ofVec3f);
+        auto bytes = (end - begin) * sizeof(ofVec3f);
+        vbo.getVertexBuffer().updateData(offset, bytes, &mesh.getVertices()[begin]);
+        if (hasNormals) {
+            vbo.getNormalBuffer().updateData(offset, bytes, &mesh.getNormals()[begin]);
         }
     }
+    mesh.haveVertsChanged();
+    mesh.haveNormalsChanged();
+}
 
-    _redrawMesh = true;
+Quad::Quad() : _edgeMapValid(true), _normalsValid(false), _redrawMesh(true),
+      _meshSmoothShading(true), _redrawWireframe(true)
+{
+
+}
+
+Quad::Quad(string objFilename)
+    : _edgeMapValid(true), _normalsValid(false), _redrawMesh(true),
+      _meshSmoothShading(true), _redrawWireframe(true)
+{
+    load(objFilename);
+}
+
+// Load mesh data from OBJ file. Vertices and faces are added to any
+// existing mesh data.
+// Mesh in OBJ file is restricted to 4 sided polygons.
+void Quad::load(std::string objFilename, Executor *executor)
+{
+    auto obj = readObj(objFilename, executor);
+
+    VertexID firstVertex = _vertices.size();
+    OFXQUAD_COUNT(_stats.allocations, reallocates(_vertices, _vertices.size() + obj.vertices.size()));
+    _vertices.reserve(_vertices.size() + obj.vertices.size());
+    for (auto &position: obj.vertices) {
+        addVertex(position);
+    }
+    if (firstVertex != 0) {
+        for (auto &face: obj.faces) {
+            for (auto &v: face) {
+                v += firstVertex;
+            }
+        }
+    }
+    addFaces(obj.faces);
+
+    meshChanged();
 }
 
 // Given vertex position, add new vertex to mesh
@@ -70,45 +144,123 @@ void Quad::load(std::string objFilename)
 VertexID Quad::addVertex(ofVec3f vertex)
 {
     // Initialize normal of vertex to all zeros. This will be calculated later.
-    // Initialize new vertex ID to -1. This is used internally when doing
-    // subdivision surface calculations.
-    _vertices.push_back({vertex, {0.0, 0.0, 0.0}, -1});
-    _redrawMesh = true;
+    OFXQUAD_COUNT(_stats.allocations, reallocates(_vertices, _vertices.size() + 1));
+    _vertices.push_back({vertex, {0.0, 0.0, 0.0}});
+    resizeAttributes();
+    meshChanged();
     return _vertices.size() - 1;
 }
 
+// Set position of existing vertex. Mesh will be rebuilt on next draw.
+void Quad::setVertex(VertexID vertex, ofVec3f position)
+{
+    _vertices[vertex].position = position;
+    meshChanged();
+}
+
+ofVec3f Quad::getVertex(VertexID vertex) const
+{
+    return _vertices[vertex].position;
+}
+
+void Quad::getPoints(PointArray &positions, PointArray &normals, Executor *executor) const
+{
+    const size_t blockSize = 4096;
+
+    positions.resize(_vertices.size());
+    normals.resize(_vertices.size());
+    parallelForBlocks(executor, _vertices.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto v = begin; v < end; v++) {
+            positions.set(v, _vertices[v].position);
+            normals.set(v, _vertices[v].normal);
+        }
+    });
+}
+
+size_t Quad::getNumVertices() const
+{
+    return _vertices.size();
+}
+
+size_t Quad::getNumFaces() const
+{
+    return _faces.size();
+}
+
+size_t Quad::getMemoryUsage() const
+{
+    auto stats = getStats();
+    return stats.vertexBytes + stats.edgeBytes + stats.faceBytes + stats.edgeMapBytes +
+           stats.attributeBytes + stats.meshBytes;
+}
+
+QuadStats Quad::getStats() const
+{
+    auto stats = _stats;
+    stats.vertexBytes = _vertices.capacity() * sizeof(Vertex);
+    stats.edgeBytes = _edges.capacity() * sizeof(Edge);
+    stats.faceBytes = _faces.capacity() * sizeof(Face);
+
+    // One pointer per bucket, and a node holding entry and next pointer per
+    // entry
+    stats.edgeMapBytes = _edgeMap.bucket_count() * sizeof(void *) +
+                         _edgeMap.size() * (sizeof(pair<const EdgeKey, EdgeID>) + sizeof(void *));
+
+    stats.attributeBytes = 0;
+    for (auto &channel: _attributes) {
+        stats.attributeBytes += channel.values.capacity() * sizeof(float);
+    }
+
+    stats.meshBytes = 0;
+    for (auto mesh: {&_mesh, &_wireframe}) {
+        stats.meshBytes += mesh->getVertices().capacity() * sizeof(ofVec3f) +
+                           mesh->getNormals().capacity() * sizeof(ofVec3f) +
+                           mesh->getIndices().capacity() * sizeof(ofIndexType);
+    }
+    return stats;
+}
+
+void Quad::resetStats()
+{
+    _stats = QuadStats();
+}
+
 // Given four valid vertex IDs, add new face to mesh
 // and return face ID of new face
 FaceID Quad::addFace(VertexID v0, VertexID v1, VertexID v2, VertexID v3)
 {
-    _edges.push_back({v0, -1, -1, -1, -1});
-    EdgeID edge0 = _edges.size() - 1;
+    if (!_edgeMapValid) {
+        buildEdgeMap();
+    }
 
-    _edges.push_back({v1, -1, -1, -1, -1});
-    EdgeID edge1 = _edges.size() - 1;
-    
-    _edges.push_back({v2, -1, -1, -1, -1});
-    EdgeID edge2 = _edges.size() - 1;
-    
-    _edges.push_back({v3, -1, -1, -1, -1});
-    EdgeID edge3 = _edges.size() - 1;
+    FaceID face = _faces.size();
+    EdgeID edge0 = faceEdge(face, 0);
+    EdgeID edge1 = faceEdge(face, 1);
+    EdgeID edge2 = faceEdge(face, 2);
+    EdgeID edge3 = faceEdge(face, 3);
 
-    _edges[edge0].next = edge1;
-    _edges[edge1].next = edge2;
-    _edges[edge2].next = edge3;
-    _edges[edge3].next = edge0;
+    OFXQUAD_COUNT(_stats.allocations, reallocates(_edges, _edges.size() + 4) +
+                                      reallocates(_faces, _faces.size() + 1));
+    _edges.push_back({v0, -1});
+    _edges.push_back({v1, -1});
+    _edges.push_back({v2, -1});
+    _edges.push_back({v3, -1});
+    _faces.push_back({{0.0, 0.0, 0.0}});
 
     // function for attaching an edge to an adjacent edge, if exists.
     // Given two vertex IDs, search for existing edge with those vertices
     // as endpoints.
     auto attachEdge = [this](EdgeID edge, VertexID a, VertexID b) {
         auto neighborEdge = findEdge(a, b);
+        OFXQUAD_COUNT(_stats.edgeMapLookups, 1);
         if (neighborEdge == -1) {
+            OFXQUAD_COUNT(_stats.allocations, 1);
             _edgeMap[makeEdgeKey(a, b)] = edge;
         }
         else {
             _edges[neighborEdge].opposite = edge;
             _edges[edge].opposite = neighborEdge;
+            _edgeMap.erase(makeEdgeKey(a, b));
         }
     };
 
@@ -118,80 +270,377 @@ FaceID Quad::addFace(VertexID v0, VertexID v1, VertexID v2, VertexID v3)
     attachEdge(edge2, v2, v3);
     attachEdge(edge3, v3, v0);
 
-    _faces.push_back({edge0, edge1, edge2, edge3, -1});
-    FaceID face = _faces.size() - 1;
+    resizeAttributes();
+    meshChanged();
+    return face;
+}
 
-    _edges[edge0].face = face;
-    _edges[edge1].face = face;
-    _edges[edge2].face = face;
-    _edges[edge3].face = face;
+FaceID Quad::addFaces(const vector<array<VertexID, 4>> &faces)
+{
+    return addFaces(faces.data(), faces.size());
+}
 
-    _redrawMesh = true;
-    return face;
+// Add faces without touching edge map. All half-edges without an opposite,
+// old and new, are bucketed by their lower endpoint with a counting sort.
+// Opposite half-edges land in the same bucket, which only holds a few
+// half-edges, so they are paired by a short scan of the bucket.
+FaceID Quad::addFaces(const array<VertexID, 4> *faces, size_t numFaces)
+{
+    // Checked before mesh is changed, since IDs index buckets below
+    VertexID numVertices = _vertices.size();
+    for (size_t i = 0; i < numFaces; i++) {
+        for (int k = 0; k < 4; k++) {
+            if (faces[i][k] < 0 || faces[i][k] >= numVertices) {
+                throw invalid_argument("face " + to_string(i) + " has invalid vertex ID " +
+                                       to_string(faces[i][k]));
+            }
+        }
+    }
+
+    FaceID firstFace = _faces.size();
+    EdgeID firstEdge = _edges.size();
+
+    OFXQUAD_COUNT(_stats.allocations, reallocates(_faces, _faces.size() + numFaces) +
+                                      reallocates(_edges, _edges.size() + 4 * numFaces));
+    _faces.resize(_faces.size() + numFaces);
+    _edges.resize(_edges.size() + 4 * numFaces);
+    for (size_t i = 0; i < numFaces; i++) {
+        for (int k = 0; k < 4; k++) {
+            _edges[firstEdge + 4 * i + k] = {faces[i][k], -1};
+        }
+    }
+
+    auto needsOpposite = [this, firstEdge](EdgeID e) {
+        return e >= firstEdge || _edges[e].opposite == -1;
+    };
+    auto lowVertex = [this](EdgeID e) {
+        return min(_edges[e].vertex, _edges[nextEdge(e)].vertex);
+    };
+    auto highVertex = [this](EdgeID e) {
+        return max(_edges[e].vertex, _edges[nextEdge(e)].vertex);
+    };
+
+    // Counting sort of half-edges by lower endpoint. Half-edges keep
+    // ascending ID order within each bucket, and carry their upper
+    // endpoint so pairing doesn't need to look at edges again.
+    vector<EdgeID> bucketOffsets(_vertices.size() + 1, 0);
+    EdgeID numSorted = 0;
+    for (EdgeID e = 0; e < EdgeID(_edges.size()); e++) {
+        if (needsOpposite(e)) {
+            bucketOffsets[lowVertex(e) + 1]++;
+            numSorted++;
+        }
+    }
+    for (size_t v = 0; v < _vertices.size(); v++) {
+        bucketOffsets[v + 1] += bucketOffsets[v];
+    }
+    vector<pair<EdgeID, VertexID>> sorted(numSorted);
+    {
+        vector<EdgeID> fill(bucketOffsets.begin(), bucketOffsets.end() - 1);
+        for (EdgeID e = 0; e < EdgeID(_edges.size()); e++) {
+            if (needsOpposite(e)) {
+                sorted[fill[lowVertex(e)]++] = {e, highVertex(e)};
+            }
+        }
+    }
+
+    // Pair each half-edge with first later half-edge in bucket that has
+    // same upper endpoint. Paired entries are marked by clearing their
+    // upper endpoint.
+    for (size_t v = 0; v < _vertices.size(); v++) {
+        for (auto i = bucketOffsets[v]; i < bucketOffsets[v + 1]; i++) {
+            if (sorted[i].second == -1) {
+                continue;
+            }
+            for (auto j = i + 1; j < bucketOffsets[v + 1]; j++) {
+                if (sorted[j].second == sorted[i].second) {
+                    auto e0 = sorted[i].first;
+                    auto e1 = sorted[j].first;
+                    _edges[e0].opposite = e1;
+                    _edges[e1].opposite = e0;
+                    sorted[j].second = -1;
+                    break;
+                }
+            }
+        }
+    }
+
+    _edgeMap.clear();
+    _edgeMapValid = false;
+    resizeAttributes();
+    meshChanged();
+    return firstFace;
+}
+
+void Quad::releaseEdgeMap()
+{
+    unordered_map<EdgeKey, EdgeID, EdgeHash>().swap(_edgeMap);
+    _edgeMapValid = false;
+}
+
+size_t Quad::addAttribute(const string &name, int width, AttributeRule rule)
+{
+    if (width <= 0) {
+        throw invalid_argument("attribute width must be positive");
+    }
+    if (findAttribute(name) != -1) {
+        throw invalid_argument("attribute " + name + " already exists");
+    }
+    _attributes.push_back({name, width, rule, {}});
+    resizeAttributes();
+    return _attributes.size() - 1;
+}
+
+void Quad::removeAttribute(size_t channel)
+{
+    if (channel >= _attributes.size()) {
+        throw out_of_range("attribute channel out of range");
+    }
+    _attributes.erase(_attributes.begin() + channel);
+}
+
+size_t Quad::getNumAttributes() const
+{
+    return _attributes.size();
+}
+
+int Quad::findAttribute(const string &name) const
+{
+    for (size_t c = 0; c < _attributes.size(); c++) {
+        if (_attributes[c].name == name) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+AttributeChannel &Quad::getAttribute(size_t channel)
+{
+    return _attributes.at(channel);
+}
+
+const AttributeChannel &Quad::getAttribute(size_t channel) const
+{
+    return _attributes.at(channel);
+}
+
+void Quad::resizeAttributes()
+{
+    for (auto &channel: _attributes) {
+        auto count = channel.rule == AttributeRule::Vertex ? _vertices.size() : _edges.size();
+        channel.values.resize(count * channel.width, 0.0f);
+    }
+}
+
+void Quad::getRenderBufferSize(bool smoothShading, size_t &numVertices,
+                               size_t &numIndices) const
+{
+    numVertices = smoothShading ? _vertices.size() : 4 * _faces.size();
+    numIndices = 6 * _faces.size();
+}
+
+// Each quad is split into triangles (v0, v1, v2) and (v0, v2, v3)
+void Quad::fillRenderBuffer(bool smoothShading, ofVec3f *positions, ofVec3f *normals,
+                            ofIndexType *indices, Executor *executor) const
+{
+    const size_t blockSize = 4096;
+
+    size_t numVertices, numIndices;
+    getRenderBufferSize(smoothShading, numVertices, numIndices);
+    if (numVertices > 0 && numVertices - 1 > numeric_limits<ofIndexType>::max()) {
+        throw overflow_error("Too many vertices for ofIndexType");
+    }
+
+    if (smoothShading) {
+        parallelForBlocks(executor, _vertices.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto v = begin; v < end; v++) {
+                positions[v] = _vertices[v].position;
+                normals[v] = _vertices[v].normal;
+            }
+        });
+        parallelForBlocks(executor, _faces.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto face = begin; face < end; face++) {
+                auto i = &indices[6 * face];
+                i[0] = _edges[faceEdge(face, 0)].vertex;
+                i[1] = _edges[faceEdge(face, 1)].vertex;
+                i[2] = _edges[faceEdge(face, 2)].vertex;
+                i[3] = i[0];
+                i[4] = i[2];
+                i[5] = _edges[faceEdge(face, 3)].vertex;
+            }
+        });
+    }
+    else {
+        parallelForBlocks(executor, _faces.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto face = begin; face < end; face++) {
+                for (int corner = 0; corner < 4; corner++) {
+                    positions[4 * face + corner] = _vertices[_edges[faceEdge(face, corner)].vertex].position;
+                    normals[4 * face + corner] = _faces[face].normal;
+                }
+                ofIndexType first = 4 * face;
+                auto i = &indices[6 * face];
+                i[0] = first;
+                i[1] = first + 1;
+                i[2] = first + 2;
+                i[3] = first;
+                i[4] = first + 2;
+                i[5] = first + 3;
+            }
+        });
+    }
+}
+
+// Render vertices follow mesh vertices with smooth shading and half-edges
+// with flat shading, so values are copied from vertex or corner of each.
+// Smooth face-varying values come from half-edge that owns each vertex.
+void Quad::fillAttributeBuffer(bool smoothShading, size_t channel, float *values,
+                               Executor *executor) const
+{
+    const size_t blockSize = 4096;
+    auto &attribute = _attributes.at(channel);
+    size_t width = attribute.width;
+    auto source = attribute.values.data();
+    auto copyValues = [&](size_t to, size_t from) {
+        copy(source + width * from, source + width * (from + 1), values + width * to);
+    };
+
+    if (attribute.rule == AttributeRule::Vertex) {
+        if (smoothShading) {
+            copy(attribute.values.begin(), attribute.values.end(), values);
+            return;
+        }
+        parallelForBlocks(executor, _edges.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto e = begin; e < end; e++) {
+                copyValues(e, _edges[e].vertex);
+            }
+        });
+    }
+    else if (!smoothShading) {
+        copy(attribute.values.begin(), attribute.values.end(), values);
+    }
+    else {
+        fill(values, values + width * _vertices.size(), 0.0f);
+        parallelForBlocks(executor, _edges.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto e = begin; e < end; e++) {
+                if (ownsVertex(e)) {
+                    copyValues(_edges[e].vertex, e);
+                }
+            }
+        });
+    }
+}
+
+void Quad::patchRenderBuffer(bool smoothShading, const vector<VertexID> &vertices,
+                             const vector<FaceID> &faces, ofVec3f *positions,
+                             ofVec3f *normals) const
+{
+    if (smoothShading) {
+        for (auto v: vertices) {
+            positions[v] = _vertices[v].position;
+            normals[v] = _vertices[v].normal;
+        }
+    }
+    else {
+        for (auto face: faces) {
+            for (int corner = 0; corner < 4; corner++) {
+                positions[4 * face + corner] = _vertices[_edges[faceEdge(face, corner)].vertex].position;
+                normals[4 * face + corner] = _faces[face].normal;
+            }
+        }
+    }
 }
 
 // Draw mesh using either flat shading or smooth shading
 void Quad::draw(bool smoothShading)
 {
-    // If mesh has changed, build OpenFrameworks tri mesh out of quad mesh
-    // and draw tri mesh
-    if (_redrawMesh) {
-        _mesh.clear();
-        calculateNormals();
-
-        for (auto &f: _faces) {
-            auto v0 = _vertices[_edges[f.edges[0]].vertex];
-            auto v1 = _vertices[_edges[f.edges[1]].vertex];
-            auto v2 = _vertices[_edges[f.edges[2]].vertex];
-            auto v3 = _vertices[_edges[f.edges[3]].vertex];
-
-            _mesh.addVertex(v0.position);
-            _mesh.addVertex(v1.position);
-            _mesh.addVertex(v2.position);
-
-            _mesh.addVertex(v0.position);
-            _mesh.addVertex(v2.position);
-            _mesh.addVertex(v3.position);
-            
-            if (smoothShading) {
-                _mesh.addNormal(v0.normal);
-                _mesh.addNormal(v1.normal);
-                _mesh.addNormal(v2.normal);
-                _mesh.addNormal(v0.normal);
-                _mesh.addNormal(v2.normal);
-                _mesh.addNormal(v3.normal);
-            } else {
-                _mesh.addNormal(f.normal);
-                _mesh.addNormal(f.normal);
-                _mesh.addNormal(f.normal);
-                _mesh.addNormal(f.normal);
-                _mesh.addNormal(f.normal);
-                _mesh.addNormal(f.normal);
-            }
+    // If mesh or shading has changed, rebuild OpenFrameworks tri mesh out
+    // of quad mesh. Arrays are filled in place and uploaded by ofVboMesh
+    // in one go.
+    if (_redrawMesh || smoothShading != _meshSmoothShading) {
+        if (!_normalsValid) {
+            calculateNormals();
         }
+        OFXQUAD_TIME_PHASE(_stats, QuadPhase::MeshRebuild);
+
+        size_t numVertices, numIndices;
+        getRenderBufferSize(smoothShading, numVertices, numIndices);
+        auto &positions = _mesh.getVertices();
+        auto &normals = _mesh.getNormals();
+        auto &indices = _mesh.getIndices();
+        OFXQUAD_COUNT(_stats.allocations, reallocates(positions, numVertices) +
+                                          reallocates(normals, numVertices) +
+                                          reallocates(indices, numIndices));
+        positions.resize(numVertices);
+        normals.resize(numVertices);
+        indices.resize(numIndices);
+        fillRenderBuffer(smoothShading, positions.data(), normals.data(), indices.data());
 
         _redrawMesh = false;
+        _meshSmoothShading = smoothShading;
     }
     _mesh.draw();
 }
 
+// Each edge is drawn once, by its half-edge with lower ID. Half-edges
+// without an opposite are drawn too.
+size_t Quad::getWireframeIndexCount() const
+{
+    size_t count = 0;
+    for (size_t e = 0; e < _edges.size(); e++) {
+        auto opposite = _edges[e].opposite;
+        count += opposite == -1 || EdgeID(e) < opposite;
+    }
+    return 2 * count;
+}
+
+void Quad::fillWireframeIndices(ofIndexType *indices) const
+{
+    if (!_vertices.empty() && _vertices.size() - 1 > numeric_limits<ofIndexType>::max()) {
+        throw overflow_error("Too many vertices for ofIndexType");
+    }
+
+    for (size_t e = 0; e < _edges.size(); e++) {
+        auto opposite = _edges[e].opposite;
+        if (opposite == -1 || EdgeID(e) < opposite) {
+            *indices++ = _edges[e].vertex;
+            *indices++ = _edges[nextEdge(e)].vertex;
+        }
+    }
+}
+
+// Draw every edge as one batch of lines. Line indices are only rebuilt
+// when mesh changes.
 void Quad::drawWireframe()
 {
-    for (auto &f: _faces) {
-        auto v0 = _vertices[_edges[f.edges[0]].vertex];
-        auto v1 = _vertices[_edges[f.edges[1]].vertex];
-        auto v2 = _vertices[_edges[f.edges[2]].vertex];
-        auto v3 = _vertices[_edges[f.edges[3]].vertex];
-        ofLine(v0.position, v1.position);
-        ofLine(v1.position, v2.position);
-        ofLine(v2.position, v3.position);
-        ofLine(v3.position, v0.position);
+    if (_redrawWireframe) {
+        OFXQUAD_TIME_PHASE(_stats, QuadPhase::MeshRebuild);
+        _wireframe.setMode(OF_PRIMITIVE_LINES);
+
+        auto &positions = _wireframe.getVertices();
+        auto &indices = _wireframe.getIndices();
+        auto numIndices = getWireframeIndexCount();
+        OFXQUAD_COUNT(_stats.allocations, reallocates(positions, _vertices.size()) +
+                                          reallocates(indices, numIndices));
+        positions.resize(_vertices.size());
+        for (size_t v = 0; v < _vertices.size(); v++) {
+            positions[v] = _vertices[v].position;
+        }
+
+        indices.resize(numIndices);
+        fillWireframeIndices(indices.data());
+
+        _redrawWireframe = false;
     }
+    _wireframe.draw();
 }
 
 EdgeID Quad::findEdge(VertexID v0, VertexID v1)
 {
+    if (!_edgeMapValid) {
+        buildEdgeMap();
+    }
     auto key = makeEdgeKey(v0, v1);
+    OFXQUAD_COUNT(_stats.edgeMapLookups, 1);
     auto result = _edgeMap.find(key);
     if (result == _edgeMap.end()) {
         return -1;
@@ -199,162 +648,1009 @@ EdgeID Quad::findEdge(VertexID v0, VertexID v1)
     return result->second;
 }
 
+// Rebuild edge map from half-edges that don't have an opposite yet
+void Quad::buildEdgeMap()
+{
+    _edgeMap.clear();
+    for (size_t e = 0; e < _edges.size(); e++) {
+        if (_edges[e].opposite == -1) {
+            auto v0 = _edges[e].vertex;
+            auto v1 = _edges[nextEdge(e)].vertex;
+            _edgeMap.insert({makeEdgeKey(v0, v1), EdgeID(e)});
+            OFXQUAD_COUNT(_stats.edgeMapLookups, 1);
+            OFXQUAD_COUNT(_stats.allocations, 1);
+        }
+    }
+    _edgeMapValid = true;
+}
+
 // Catmull-Clark subdivision surface algorithm
-Quad Quad::subdivide(int level)
-{
-    if (level == 0) {
-        return *this;
-    }
-
-    for (auto &v: _vertices) {
-        v.newVertex = -1;
-    }
-    
-    vector<ofVec3f> newVertices;
-        
-    // Divide existing face into four new faces, using the four existing face
-    // vertices and a new vertex at the center of existing face. Calculate new
-    // vertex in center of existing face by averaging four corner vertices
-    // of face.
-    for (auto &f: _faces) {
-        newVertices.push_back((_vertices[_edges[f.edges[0]].vertex].position +
-                               _vertices[_edges[f.edges[1]].vertex].position +
-                               _vertices[_edges[f.edges[2]].vertex].position +
-                               _vertices[_edges[f.edges[3]].vertex].position) / 4.0f);
-        f.center = newVertices.size() - 1;
-    }
-
-    // Divide existing edge into two new edges, using edge endpoints and new
-    // vertex around the midpoint of edge. Calculate new vertex on existing
-    // edge by averaging the endpoints of edge and the centers of the two
-    // adjacent faces.
-    auto newMidpoint = [this, &newVertices](EdgeID edge, VertexID a, VertexID b) {
-        // Check to see if new midpoint has already been calculated for
-        // opposite edge
-        if (_edges[_edges[edge].opposite].midpoint == -1) {
-            auto newVertex = (_vertices[a].position +
-                              _vertices[b].position +
-                              newVertices[_faces[_edges[edge].face].center] +
-                              newVertices[_faces[_edges[_edges[edge].opposite].face].center]) / 4.0f;
-            newVertices.push_back(newVertex);
-            _edges[edge].midpoint = newVertices.size() - 1;
-            _edges[_edges[edge].opposite].midpoint = newVertices.size() - 1;
+Quad Quad::subdivide(int level) const
+{
+    return subdivide(level, SubdivideOptions());
+}
+
+// Only mesh data is copied; edge map and draw buffers of this mesh aren't
+// needed by subdivided mesh
+Quad Quad::subdivide(int level, const SubdivideOptions &options) const
+{
+    Quad quad;
+    quad._vertices = _vertices;
+    quad._edges = _edges;
+    quad._faces = _faces;
+    quad._attributes = _attributes;
+    quad._edgeMapValid = false;
+    quad.subdivideInPlace(level, options);
+    return quad;
+}
+
+// Each face, edge and vertex of existing mesh produces exactly one new
+// vertex, so new vertex IDs are known up front: face points first, then
+// edge points, then vertex points. Every new vertex is written by exactly
+// one loop iteration, so loops can be split across threads in any way
+// without changing the result. Odd levels are built in scratch arrays and
+// even levels in arrays of this mesh.
+void Quad::subdivideInPlace(int level, const SubdivideOptions &options)
+{
+    if (level < 0) {
+        throw invalid_argument("subdivision level must not be negative");
+    }
+    // Edge and vertex points have no border rules
+    if (level > 0) {
+        for (auto &edge: _edges) {
+            if (edge.opposite == -1) {
+                throw invalid_argument("subdivision requires a closed mesh");
+            }
+        }
+    }
+    auto executor = options.executor;
+    if (options.reorder) {
+        reorder(options.order);
+    }
+
+    // Sizes of each level follow from counts of this one
+    size_t numVertices = _vertices.size();
+    size_t numFaces = _faces.size();
+    size_t numUniqueEdges = 0;
+    for (size_t e = 0; e < _edges.size(); e++) {
+        numUniqueEdges += EdgeID(e) < _edges[e].opposite;
+    }
+    Quad scratch;
+    size_t numMidpoints = 0;
+    for (int i = 1; i <= level; i++) {
+        numMidpoints = 4 * numFaces;
+        numVertices += numUniqueEdges + numFaces;
+        numUniqueEdges = 2 * numUniqueEdges + 4 * numFaces;
+        numFaces *= 4;
+
+        auto &target = i % 2 ? scratch : *this;
+        if (i >= level - 1) {
+            OFXQUAD_COUNT(_stats.allocations, reallocates(target._vertices, numVertices) +
+                                              reallocates(target._edges, 4 * numFaces) +
+                                              reallocates(target._faces, numFaces));
+            target._vertices.reserve(numVertices);
+            target._edges.reserve(4 * numFaces);
+            target._faces.reserve(numFaces);
+        }
+    }
+    vector<VertexID> midpoints;
+    OFXQUAD_COUNT(_stats.allocations, numMidpoints > 0);
+    midpoints.reserve(numMidpoints);
+    for (auto &channel: _attributes) {
+        scratch._attributes.push_back({channel.name, channel.width, channel.rule, {}});
+    }
+
+    // One-rings are only walked to classify vertices of this level
+    VertexClasses classes;
+    VertexClasses childClasses;
+    if (level > 0) {
+        OFXQUAD_TIME_PHASE(scratch._stats, QuadPhase::VertexPoints);
+        classifyVertices(executor, classes);
+    }
+
+    Quad *parent = this;
+    Quad *child = &scratch;
+    for (int i = 0; i < level; i++) {
+        // Phases are counted in child, and stats of scratch are added to
+        // this mesh at the end
+        size_t numEdgePoints;
+        {
+            OFXQUAD_TIME_PHASE(child->_stats, QuadPhase::EdgePoints);
+            parent->edgePoints(executor, midpoints, numEdgePoints);
+        }
+        child->_vertices.resize(parent->_faces.size() + numEdgePoints + parent->_vertices.size());
+
+        parent->subdividePoints(*child, midpoints, classes, executor);
+
+        {
+            OFXQUAD_TIME_PHASE(child->_stats, QuadPhase::ChildTopology);
+            if (options.directTopology) {
+                parent->buildChildTopology(*child, midpoints, executor);
+            }
+            else {
+                parent->addChildFaces(*child, midpoints);
+            }
+        }
+        if (!_attributes.empty()) {
+            parent->subdivideAttributes(*child, midpoints, classes, executor);
+        }
+        if (i + 1 < level) {
+            OFXQUAD_TIME_PHASE(child->_stats, QuadPhase::VertexPoints);
+            parent->childVertexClasses(midpoints, numEdgePoints, classes, childClasses, executor);
+            swap(classes, childClasses);
+        }
+
+        auto numChildFaces = 4 * parent->_faces.size();
+        if (i + 1 < level) {
+            // Parent arrays keep their capacity for level after next
+            parent->_vertices.clear();
+            parent->_edges.clear();
+            parent->_faces.clear();
+            for (auto &channel: parent->_attributes) {
+                channel.values.clear();
+            }
+        }
+        else {
+            // Nothing is built in parent arrays again. They are freed
+            // before faces of last level are allocated, so that peak
+            // memory is last level without its faces plus the level
+            // before.
+            vector<Vertex>().swap(parent->_vertices);
+            vector<Edge>().swap(parent->_edges);
+            vector<Face>().swap(parent->_faces);
+            vector<VertexID>().swap(midpoints);
+            for (auto &channel: parent->_attributes) {
+                vector<float>().swap(channel.values);
+            }
+        }
+        parent->_edgeMap.clear();
+        parent->_edgeMapValid = true;
+        // Faces only hold normals, which aren't needed until drawing
+        child->_faces.resize(numChildFaces);
+        swap(parent, child);
+    }
+    if (parent != this) {
+        swapMeshData(scratch);
+    }
+    if (options.reorder && level > 0) {
+        renumberVertices();
+    }
+#if OFXQUAD_STATS
+    _stats += scratch._stats;
+#endif
+
+    meshChanged();
+    if (options.limitSurface) {
+        projectToLimit(executor);
+    }
+}
+
+void Quad::swapMeshData(Quad &other)
+{
+    _vertices.swap(other._vertices);
+    _edges.swap(other._edges);
+    _faces.swap(other._faces);
+    _edgeMap.swap(other._edgeMap);
+    swap(_edgeMapValid, other._edgeMapValid);
+    _attributes.swap(other._attributes);
+}
+
+// Faces are ordered first, and vertices then follow faces
+void Quad::reorder(MeshOrder order)
+{
+    auto numFaces = _faces.size();
+    vector<FaceID> newToOld;
+    newToOld.reserve(numFaces);
+
+    if (order == MeshOrder::Morton && numFaces > 0) {
+        ofVec3f boxMin = _vertices[_edges[0].vertex].position;
+        ofVec3f boxMax = boxMin;
+        for (auto &edge: _edges) {
+            auto &p = _vertices[edge.vertex].position;
+            for (int i = 0; i < 3; i++) {
+                boxMin[i] = min(boxMin[i], p[i]);
+                boxMax[i] = max(boxMax[i], p[i]);
+            }
+        }
+        vector<pair<uint64_t, FaceID>> codes(numFaces);
+        for (size_t f = 0; f < numFaces; f++) {
+            codes[f] = {mortonCode(facePoint(f), boxMin, boxMax - boxMin), FaceID(f)};
+        }
+        sort(codes.begin(), codes.end());
+        for (auto &code: codes) {
+            newToOld.push_back(code.second);
+        }
+    }
+    else if (order == MeshOrder::Breadth) {
+        // newToOld doubles as queue; each disconnected part starts from
+        // its lowest face
+        vector<bool> visited(numFaces, false);
+        for (size_t start = 0; start < numFaces; start++) {
+            if (visited[start]) {
+                continue;
+            }
+            visited[start] = true;
+            auto head = newToOld.size();
+            newToOld.push_back(start);
+            for (; head < newToOld.size(); head++) {
+                for (int i = 0; i < 4; i++) {
+                    auto opposite = _edges[faceEdge(newToOld[head], i)].opposite;
+                    if (opposite != -1 && !visited[edgeFace(opposite)]) {
+                        visited[edgeFace(opposite)] = true;
+                        newToOld.push_back(edgeFace(opposite));
+                    }
+                }
+            }
+        }
+    }
+
+    if (!newToOld.empty()) {
+        permuteFaces(newToOld);
+    }
+    renumberVertices();
+    meshChanged();
+}
+
+void Quad::permuteFaces(const vector<FaceID> &newToOld)
+{
+    vector<FaceID> oldToNew(_faces.size());
+    for (size_t f = 0; f < newToOld.size(); f++) {
+        oldToNew[newToOld[f]] = f;
+    }
+
+    vector<Edge> edges(_edges.size());
+    vector<Face> faces(_faces.size());
+    for (size_t f = 0; f < newToOld.size(); f++) {
+        auto old = newToOld[f];
+        faces[f] = _faces[old];
+        for (int i = 0; i < 4; i++) {
+            auto edge = _edges[faceEdge(old, i)];
+            if (edge.opposite != -1) {
+                edge.opposite = faceEdge(oldToNew[edgeFace(edge.opposite)], edge.opposite & 3);
+            }
+            edges[faceEdge(f, i)] = edge;
+        }
+    }
+    _edges.swap(edges);
+    _faces.swap(faces);
+
+    // Corners of a face move together
+    for (auto &channel: _attributes) {
+        if (channel.rule == AttributeRule::FaceVarying) {
+            scatterValues(channel.values, 4 * channel.width, oldToNew);
+        }
+    }
+}
+
+// New vertices are copied back so arrays keep their capacity, which
+// subdivideInPlace() relies on. Edge map is keyed by old IDs, so it is
+// dropped.
+void Quad::renumberVertices()
+{
+    vector<VertexID> oldToNew(_vertices.size(), -1);
+    vector<Vertex> vertices;
+    vertices.reserve(_vertices.size());
+    for (auto &edge: _edges) {
+        auto &id = oldToNew[edge.vertex];
+        if (id == -1) {
+            id = vertices.size();
+            vertices.push_back(_vertices[edge.vertex]);
+        }
+        edge.vertex = id;
+    }
+    for (size_t v = 0; v < _vertices.size(); v++) {
+        if (oldToNew[v] == -1) {
+            oldToNew[v] = vertices.size();
+            vertices.push_back(_vertices[v]);
+        }
+    }
+    copy(vertices.begin(), vertices.end(), _vertices.begin());
+    for (auto &channel: _attributes) {
+        if (channel.rule == AttributeRule::Vertex) {
+            scatterValues(channel.values, channel.width, oldToNew);
+        }
+    }
+
+    _edgeMap.clear();
+    _edgeMapValid = false;
+}
+
+// Divide existing face into four new faces, using the four existing face
+// vertices and a new vertex at the center of existing face. Calculate new
+// vertex in center of existing face by averaging four corner vertices
+// of face.
+ofVec3f Quad::facePoint(FaceID face) const
+{
+    return (_vertices[_edges[faceEdge(face, 0)].vertex].position +
+            _vertices[_edges[faceEdge(face, 1)].vertex].position +
+            _vertices[_edges[faceEdge(face, 2)].vertex].position +
+            _vertices[_edges[faceEdge(face, 3)].vertex].position) / 4.0f;
+}
+
+// Divide existing edge into two new edges, using edge endpoints and new
+// vertex around the midpoint of edge. Calculate new vertex on existing
+// edge by averaging the endpoints of edge and the centers of the two
+// adjacent faces, indexed by face ID.
+ofVec3f Quad::edgePoint(EdgeID e, const Vertex *facePoints) const
+{
+    auto &edge = _edges[e];
+    auto &opposite = _edges[edge.opposite];
+    return (_vertices[edge.vertex].position +
+            _vertices[opposite.vertex].position +
+            facePoints[edgeFace(e)].position +
+            facePoints[edgeFace(edge.opposite)].position) / 4.0f;
+}
+
+// Calculate new position of start vertex of edge, using the midpoints of
+// connected edges, centers of connected faces (indexed by face ID), and
+// current position. Valence value is the number of connected edges.
+ofVec3f Quad::vertexPoint(EdgeID edge, const Vertex *facePoints) const
+{
+    int valence = 0;
+    ofVec3f  sumMidpoints = {0.0, 0.0, 0.0};
+    ofVec3f sumCenters = {0.0, 0.0, 0.0};
+
+    // Loop through each connected edge of vertex
+    auto e = _edges[edge].opposite;
+    do {
+        sumMidpoints += (_vertices[_edges[e].vertex].position +
+                         _vertices[_edges[_edges[e].opposite].vertex].position) / 2.0f;
+        sumCenters += facePoints[edgeFace(e)].position;
+        valence++;
+        e = _edges[nextEdge(e)].opposite;
+    } while (_edges[e].opposite != edge);
+
+    // Formulate for calculating new vertex position
+    return ((sumCenters / valence) +
+            ((sumMidpoints / valence) * 2) +
+            (_vertices[_edges[edge].vertex].position * (valence - 3))) / valence;
+}
+
+// Ring is walked and summed in same order as vertexPoint(), and valence is
+// a constant, so divisions by 4 of regular vertices compile to
+// multiplications that round the same way. Results are bit-identical.
+template <int valence>
+ofVec3f Quad::vertexPoint(EdgeID edge, const Vertex *facePoints) const
+{
+    EdgeID ring[valence];
+    ring[0] = _edges[edge].opposite;
+    for (int i = 1; i < valence; i++) {
+        ring[i] = _edges[nextEdge(ring[i - 1])].opposite;
+    }
+
+    ofVec3f sumMidpoints = {0.0, 0.0, 0.0};
+    ofVec3f sumCenters = {0.0, 0.0, 0.0};
+    for (int i = 0; i < valence; i++) {
+        sumMidpoints += (_vertices[_edges[ring[i]].vertex].position +
+                         _vertices[_edges[_edges[ring[i]].opposite].vertex].position) / 2.0f;
+        sumCenters += facePoints[edgeFace(ring[i])].position;
+    }
+
+    const float n = valence;
+    return ((sumCenters / n) +
+            ((sumMidpoints / n) * 2) +
+            (_vertices[_edges[edge].vertex].position * (n - 3))) / n;
+}
+
+void Quad::classifyVertices(Executor *executor, VertexClasses &classes) const
+{
+    const size_t blockSize = 4096;
+    auto numEdges = _edges.size();
+
+    // Blocks fill their own batches, which are joined in block order
+    vector<VertexClasses> blockClasses((numEdges + blockSize - 1) / blockSize);
+    parallelForBlocks(executor, numEdges, blockSize, [&](size_t begin, size_t end) {
+        auto &block = blockClasses[begin / blockSize];
+        for (auto edge = begin; edge < end; edge++) {
+            if (!ownsVertex(edge)) {
+                continue;
+            }
+            int valence = 0;
+            EdgeID e = edge;
+            do {
+                valence++;
+                e = nextOutgoing(e);
+            } while (e != -1 && e != EdgeID(edge));
+
+            if (e != -1 && valence == 4) {
+                block.regular.push_back(edge);
+            }
+            else {
+                block.extraordinary.push_back(edge);
+            }
+        }
+    });
+
+    classes.regular.clear();
+    classes.extraordinary.clear();
+    for (auto &block: blockClasses) {
+        classes.regular.insert(classes.regular.end(), block.regular.begin(), block.regular.end());
+        classes.extraordinary.insert(classes.extraordinary.end(), block.extraordinary.begin(),
+                                     block.extraordinary.end());
+    }
+}
+
+// Owning half-edges follow from layout of buildChildTopology() for closed
+// meshes, which are all subdivideInPlace() accepts. Owner is
+// the outgoing half-edge with highest ID, and child half-edge k of child
+// face c is 4c+k:
+//
+//     face point of f: corner 2 of child faces 4f to 4f+3, so 16f+14
+//     edge point of e: corner 1 of child faces 4e and 4o, and corner 3 of
+//         child faces after them, where o is opposite of e
+//     vertex point of v: corner 0 of child face 4e for every outgoing e,
+//         so 4 times owner of v
+void Quad::childVertexClasses(const vector<VertexID> &midpoints, size_t numEdgePoints,
+                              const VertexClasses &classes, VertexClasses &childClasses,
+                              Executor *executor) const
+{
+    const size_t blockSize = 4096;
+    auto numFaces = _faces.size();
+    auto numEdges = _edges.size();
+    auto firstRegularPoint = numFaces + numEdgePoints;
+
+    auto &regular = childClasses.regular;
+    regular.resize(firstRegularPoint + classes.regular.size());
+    parallelForBlocks(executor, numFaces, blockSize, [&](size_t begin, size_t end) {
+        for (auto f = begin; f < end; f++) {
+            regular[f] = 4 * faceEdge(f, 3) + 2;
+        }
+    });
+    parallelForBlocks(executor, numEdges, blockSize, [&](size_t begin, size_t end) {
+        for (auto e = begin; e < end; e++) {
+            auto opposite = _edges[e].opposite;
+            if (EdgeID(e) < opposite) {
+                regular[midpoints[e]] = std::max(std::max(4 * EdgeID(e) + 1, 4 * nextEdge(e) + 3),
+                                                 std::max(4 * opposite + 1, 4 * nextEdge(opposite) + 3));
+            }
+        }
+    });
+    parallelForBlocks(executor, classes.regular.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            regular[firstRegularPoint + i] = 4 * classes.regular[i];
+        }
+    });
+
+    childClasses.extraordinary.resize(classes.extraordinary.size());
+    for (size_t i = 0; i < classes.extraordinary.size(); i++) {
+        childClasses.extraordinary[i] = 4 * classes.extraordinary[i];
+    }
+}
+
+// Calculate face, edge and vertex points of subdivided mesh on Vertex
+// structs, one point at a time
+void Quad::subdividePoints(Quad &child, const vector<VertexID> &midpoints,
+                           const VertexClasses &classes, Executor *executor) const
+{
+    // Number of items handled per block in parallel loops
+    const size_t blockSize = 4096;
+
+    auto numFaces = _faces.size();
+    auto numEdges = _edges.size();
+    auto numVertices = _vertices.size();
+    auto firstVertexPoint = child._vertices.size() - numVertices;
+
+    {
+        OFXQUAD_TIME_PHASE(child._stats, QuadPhase::FacePoints);
+        parallelForBlocks(executor, numFaces, blockSize, [&](size_t begin, size_t end) {
+            for (auto f = begin; f < end; f++) {
+                child._vertices[f].position = facePoint(f);
+            }
+        });
+    }
+
+    // Half-edge with lower ID calculates the edge point
+    {
+        OFXQUAD_TIME_PHASE(child._stats, QuadPhase::EdgePoints);
+        parallelForBlocks(executor, numEdges, blockSize, [&](size_t begin, size_t end) {
+            for (auto e = begin; e < end; e++) {
+                if (EdgeID(e) < _edges[e].opposite) {
+                    child._vertices[midpoints[e]].position = edgePoint(e, child._vertices.data());
+                }
+            }
+        });
+    }
+
+    // Vertices that aren't part of any face keep their position
+    OFXQUAD_TIME_PHASE(child._stats, QuadPhase::VertexPoints);
+    parallelForBlocks(executor, numVertices, blockSize, [&](size_t begin, size_t end) {
+        for (auto v = begin; v < end; v++) {
+            child._vertices[firstVertexPoint + v].position = _vertices[v].position;
+        }
+    });
+
+    // Vertex point is calculated by the half-edge that owns the vertex,
+    // regular vertices in one batch and the rest in another
+    parallelForBlocks(executor, classes.regular.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto edge = classes.regular[i];
+            child._vertices[firstVertexPoint + _edges[edge].vertex].position = vertexPoint<4>(edge, child._vertices.data());
+        }
+    });
+    parallelForBlocks(executor, classes.extraordinary.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto edge = classes.extraordinary[i];
+            child._vertices[firstVertexPoint + _edges[edge].vertex].position = vertexPoint(edge, child._vertices.data());
+        }
+    });
+}
+
+// Vertex channels follow same rules, and same order of sums, as
+// facePoint(), edgePoint() and vertexPoint(). Each one-ring is walked once,
+// and its half-edges reused for every channel. Face-varying corners of a
+// child face only depend on corners of its parent face: corner, edge
+// midpoints and face center.
+void Quad::subdivideAttributes(Quad &child, const vector<VertexID> &midpoints,
+                               const VertexClasses &classes, Executor *executor) const
+{
+    const size_t blockSize = 4096;
+
+    auto numFaces = _faces.size();
+    auto numEdges = _edges.size();
+    auto numVertices = _vertices.size();
+    auto firstVertexPoint = child._vertices.size() - numVertices;
+
+    vector<size_t> vertexChannels;
+    vector<size_t> faceVaryingChannels;
+    for (size_t c = 0; c < _attributes.size(); c++) {
+        auto &channel = _attributes[c];
+        if (channel.rule == AttributeRule::Vertex) {
+            vertexChannels.push_back(c);
+            child._attributes[c].values.resize(child._vertices.size() * channel.width);
         }
         else {
-            // We've already calculated the new midpoint vertex for the
-            // opposite edge; no need to calculate again.
-            _edges[edge].midpoint = _edges[_edges[edge].opposite].midpoint;
+            faceVaryingChannels.push_back(c);
+            child._attributes[c].values.resize(4 * numEdges * channel.width);
         }
-    };
+    }
 
-    for (auto &f: _faces) {
-        newMidpoint(f.edges[0], _edges[f.edges[0]].vertex, _edges[f.edges[1]].vertex);
-        newMidpoint(f.edges[1], _edges[f.edges[1]].vertex, _edges[f.edges[2]].vertex);
-        newMidpoint(f.edges[2], _edges[f.edges[2]].vertex, _edges[f.edges[3]].vertex);
-        newMidpoint(f.edges[3], _edges[f.edges[3]].vertex, _edges[f.edges[0]].vertex);
-    }
-
-    // Calculate new position of each existing vertex, using the midpoints of
-    // connected edges, centers of connected faces, and current position.
-    // Valence value is the number of connected edges.
-    auto getNewVertex = [this, &newVertices](EdgeID edge) {
-        int valence = 0;
-        ofVec3f  sumMidpoints = {0.0, 0.0, 0.0};
-        ofVec3f sumCenters = {0.0, 0.0, 0.0};
-
-        // Loop through each connected edge of vertex
-        auto e = _edges[edge].opposite;
-        do {
-            sumMidpoints += (_vertices[_edges[e].vertex].position +
-                             _vertices[_edges[_edges[e].opposite].vertex].position) / 2.0f;
-            sumCenters += newVertices[_faces[_edges[e].face].center];
-            valence++;
-            e = _edges[_edges[e].next].opposite;
-        } while (_edges[e].opposite != edge);
-
-        // Formulate for calculating new vertex position
-        auto newVertex = ((sumCenters / valence) +
-                          ((sumMidpoints / valence) * 2) +
-                          (_vertices[_edges[edge].vertex].position * (valence - 3))) / valence;
-
-        newVertices.push_back(newVertex);
-        return newVertices.size() - 1;
-    };
-    
-    for (auto &f: _faces) {
-        auto v0 = _edges[f.edges[0]].vertex;
-        auto v1 = _edges[f.edges[1]].vertex;
-        auto v2 = _edges[f.edges[2]].vertex;
-        auto v3 = _edges[f.edges[3]].vertex;
-        _vertices[v0].newVertex = getNewVertex(f.edges[0]);
-        _vertices[v1].newVertex = getNewVertex(f.edges[1]);
-        _vertices[v2].newVertex = getNewVertex(f.edges[2]);
-        _vertices[v3].newVertex = getNewVertex(f.edges[3]);
+    parallelForBlocks(executor, numFaces, blockSize, [&](size_t begin, size_t end) {
+        for (auto c: vertexChannels) {
+            size_t width = _attributes[c].width;
+            auto values = _attributes[c].values.data();
+            auto points = child._attributes[c].values.data();
+            for (auto f = begin; f < end; f++) {
+                auto v0 = values + width * _edges[faceEdge(f, 0)].vertex;
+                auto v1 = values + width * _edges[faceEdge(f, 1)].vertex;
+                auto v2 = values + width * _edges[faceEdge(f, 2)].vertex;
+                auto v3 = values + width * _edges[faceEdge(f, 3)].vertex;
+                for (size_t k = 0; k < width; k++) {
+                    points[width * f + k] = (v0[k] + v1[k] + v2[k] + v3[k]) / 4.0f;
+                }
+            }
+        }
+        for (auto c: faceVaryingChannels) {
+            size_t width = _attributes[c].width;
+            auto values = _attributes[c].values.data();
+            auto corners = child._attributes[c].values.data();
+            for (auto f = begin; f < end; f++) {
+                auto parent = values + width * faceEdge(f, 0);
+                for (int i = 0; i < 4; i++) {
+                    auto corner = parent + width * i;
+                    auto next = parent + width * ((i + 1) & 3);
+                    auto prev = parent + width * ((i + 3) & 3);
+                    auto childCorners = corners + width * 4 * faceEdge(f, i);
+                    for (size_t k = 0; k < width; k++) {
+                        childCorners[k] = corner[k];
+                        childCorners[width + k] = (corner[k] + next[k]) / 2.0f;
+                        childCorners[2 * width + k] = (parent[k] + parent[width + k] +
+                                                       parent[2 * width + k] + parent[3 * width + k]) / 4.0f;
+                        childCorners[3 * width + k] = (prev[k] + corner[k]) / 2.0f;
+                    }
+                }
+            }
+        }
+    });
+    if (vertexChannels.empty()) {
+        return;
     }
-    
-    // Build new quad
-    Quad newQuad;
-    for (auto &v: newVertices) {
-        newQuad.addVertex(v);
+
+    parallelForBlocks(executor, numEdges, blockSize, [&](size_t begin, size_t end) {
+        for (auto c: vertexChannels) {
+            size_t width = _attributes[c].width;
+            auto values = _attributes[c].values.data();
+            auto points = child._attributes[c].values.data();
+            for (auto e = begin; e < end; e++) {
+                auto &edge = _edges[e];
+                if (EdgeID(e) >= edge.opposite) {
+                    continue;
+                }
+                auto v0 = values + width * edge.vertex;
+                auto v1 = values + width * _edges[edge.opposite].vertex;
+                auto f0 = points + width * edgeFace(e);
+                auto f1 = points + width * edgeFace(edge.opposite);
+                auto point = points + width * midpoints[e];
+                for (size_t k = 0; k < width; k++) {
+                    point[k] = (v0[k] + v1[k] + f0[k] + f1[k]) / 4.0f;
+                }
+            }
+        }
+    });
+
+    // Vertices that aren't part of any face keep their values
+    parallelForBlocks(executor, numVertices, blockSize, [&](size_t begin, size_t end) {
+        for (auto c: vertexChannels) {
+            size_t width = _attributes[c].width;
+            auto values = _attributes[c].values.data();
+            auto points = child._attributes[c].values.data() + width * firstVertexPoint;
+            copy(values + width * begin, values + width * end, points + width * begin);
+        }
+    });
+
+    auto numRegular = classes.regular.size();
+    auto numOwners = numRegular + classes.extraordinary.size();
+    parallelForBlocks(executor, numOwners, blockSize, [&](size_t begin, size_t end) {
+        vector<EdgeID> ring;
+        vector<float> sumMidpoints;
+        vector<float> sumCenters;
+        for (auto i = begin; i < end; i++) {
+            auto edge = i < numRegular ? classes.regular[i] : classes.extraordinary[i - numRegular];
+            ring.clear();
+            auto e = _edges[edge].opposite;
+            do {
+                ring.push_back(e);
+                e = _edges[nextEdge(e)].opposite;
+            } while (_edges[e].opposite != edge);
+            float valence = ring.size();
+            auto v = _edges[edge].vertex;
+
+            for (auto c: vertexChannels) {
+                size_t width = _attributes[c].width;
+                auto values = _attributes[c].values.data();
+                auto points = child._attributes[c].values.data();
+                auto point = points + width * (firstVertexPoint + v);
+                sumMidpoints.assign(width, 0.0f);
+                sumCenters.assign(width, 0.0f);
+                for (auto r: ring) {
+                    auto v0 = values + width * _edges[r].vertex;
+                    auto v1 = values + width * _edges[_edges[r].opposite].vertex;
+                    auto center = points + width * edgeFace(r);
+                    for (size_t k = 0; k < width; k++) {
+                        sumMidpoints[k] += (v0[k] + v1[k]) / 2.0f;
+                        sumCenters[k] += center[k];
+                    }
+                }
+                for (size_t k = 0; k < width; k++) {
+                    point[k] = ((sumCenters[k] / valence) + ((sumMidpoints[k] / valence) * 2) +
+                                (values[width * v + k] * (valence - 3))) / valence;
+                }
+            }
+        }
+    });
+}
+
+// Number edges with a prefix sum over half-edges that own their edge (the
+// half-edge with lower ID), and return edge point ID for every half-edge.
+// Edge points come after the face points in subdivided mesh.
+vector<VertexID> Quad::edgePoints(Executor *executor, size_t &numEdgePoints) const
+{
+    vector<VertexID> midpoints;
+    edgePoints(executor, midpoints, numEdgePoints);
+    return midpoints;
+}
+
+void Quad::edgePoints(Executor *executor, vector<VertexID> &midpoints, size_t &numEdgePoints) const
+{
+    const size_t blockSize = 4096;
+    auto numEdges = _edges.size();
+
+    // Count owned edges per block, then turn counts into block offsets
+    auto numBlocks = (numEdges + blockSize - 1) / blockSize;
+    vector<size_t> blockOffsets(numBlocks + 1, 0);
+    parallelForBlocks(executor, numEdges, blockSize, [&](size_t begin, size_t end) {
+        size_t count = 0;
+        for (auto e = begin; e < end; e++) {
+            count += EdgeID(e) < _edges[e].opposite;
+        }
+        blockOffsets[begin / blockSize + 1] = count;
+    });
+    for (size_t i = 0; i < numBlocks; i++) {
+        blockOffsets[i + 1] += blockOffsets[i];
     }
+    numEdgePoints = blockOffsets[numBlocks];
+
+    midpoints.resize(numEdges);
+    parallelForBlocks(executor, numEdges, blockSize, [&](size_t begin, size_t end) {
+        VertexID midpoint = _faces.size() + blockOffsets[begin / blockSize];
+        for (auto e = begin; e < end; e++) {
+            auto opposite = _edges[e].opposite;
+            if (EdgeID(e) < opposite) {
+                midpoints[e] = midpoint;
+                midpoints[opposite] = midpoint;
+                midpoint++;
+            }
+        }
+    });
+}
+
+// Write half-edges and faces of subdivided mesh straight into child
+// arrays. Face i of parent face f becomes child face 4f+i:
+//
+//     vertex point of corner i -> edge point of edge i
+//         -> face point -> edge point of edge i-1
+//
+// Child edge k of child face c is 4c+k, so every opposite link follows
+// from parent links without any edge lookups.
+void Quad::buildChildTopology(Quad &child, const vector<VertexID> &midpoints,
+                              Executor *executor) const
+{
+    const size_t blockSize = 1024;
+    VertexID firstVertexPoint = child._vertices.size() - _vertices.size();
+
+    child._edges.resize(_edges.size() * 4);
+
+    parallelForBlocks(executor, _faces.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto f = begin; f < end; f++) {
+            for (int i = 0; i < 4; i++) {
+                auto e = faceEdge(f, i);
+                auto prev = prevEdge(e);
+                auto opposite = _edges[e].opposite;
+                auto prevOpposite = _edges[prev].opposite;
+
+                // Child face on other side of parent edge i starts at the
+                // corner after the opposite edge; child face on other side
+                // of parent edge i-1 starts at the opposite edge itself.
+                EdgeID across = 4 * nextEdge(opposite) + 3;
+                EdgeID prevAcross = 4 * prevOpposite;
+
+                EdgeID e0 = 4 * e;
+                child._edges[e0] = {firstVertexPoint + _edges[e].vertex, across};
+                child._edges[e0 + 1] = {midpoints[e], 4 * nextEdge(e) + 2};
+                child._edges[e0 + 2] = {VertexID(f), 4 * prev + 1};
+                child._edges[e0 + 3] = {midpoints[prev], prevAcross};
+            }
+        }
+    });
 
-    for (auto &f: _faces) {
-        auto e0 = _edges[f.edges[0]];
-        auto e1 = _edges[f.edges[1]];
-        auto e2 = _edges[f.edges[2]];
-        auto e3 = _edges[f.edges[3]];
+    child._edgeMapValid = false;
+}
+
+// Build subdivided mesh one face at a time through addFace()
+void Quad::addChildFaces(Quad &child, const vector<VertexID> &midpoints) const
+{
+    VertexID firstVertexPoint = child._vertices.size() - _vertices.size();
 
-        auto v0 = _vertices[e0.vertex].newVertex;
-        auto v1 = _vertices[e1.vertex].newVertex;
-        auto v2 = _vertices[e2.vertex].newVertex;
-        auto v3 = _vertices[e3.vertex].newVertex;
+    for (size_t f = 0; f < _faces.size(); f++) {
+        auto v0 = firstVertexPoint + _edges[faceEdge(f, 0)].vertex;
+        auto v1 = firstVertexPoint + _edges[faceEdge(f, 1)].vertex;
+        auto v2 = firstVertexPoint + _edges[faceEdge(f, 2)].vertex;
+        auto v3 = firstVertexPoint + _edges[faceEdge(f, 3)].vertex;
 
-        auto mp0 = e0.midpoint;
-        auto mp1 = e1.midpoint;
-        auto mp2 = e2.midpoint;
-        auto mp3 = e3.midpoint;
+        auto mp0 = midpoints[faceEdge(f, 0)];
+        auto mp1 = midpoints[faceEdge(f, 1)];
+        auto mp2 = midpoints[faceEdge(f, 2)];
+        auto mp3 = midpoints[faceEdge(f, 3)];
 
-        auto center = f.center;
+        VertexID center = f;
 
-        newQuad.addFace(v0, mp0, center, mp3);
-        newQuad.addFace(v1, mp1, center, mp0);
-        newQuad.addFace(v2, mp2, center, mp1);
-        newQuad.addFace(v3, mp3, center, mp2);
+        child.addFace(v0, mp0, center, mp3);
+        child.addFace(v1, mp1, center, mp0);
+        child.addFace(v2, mp2, center, mp1);
+        child.addFace(v3, mp3, center, mp2);
+    }
+}
+
+// True if edge is outgoing half-edge of its start vertex with highest ID.
+// Per-vertex work is done by this half-edge only, so that every vertex is
+// handled exactly once.
+bool Quad::ownsVertex(EdgeID edge) const
+{
+    auto e = nextOutgoing(edge);
+    while (e != -1 && e < edge) {
+        e = nextOutgoing(e);
     }
+    if (e != -1) {
+        return e == edge;
+    }
+
+    // Vertex is on a border, so half-edges before edge weren't visited
+    for (e = prevOutgoing(edge); e != -1; e = prevOutgoing(e)) {
+        if (e > edge) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Calculate normal for each pair of edges in face, and average together
+// to get face normal. I ~think~ this should work for slightly coplanar
+// faces.
+ofVec3f Quad::faceNormal(FaceID face) const
+{
+    auto v0 = &_vertices[_edges[faceEdge(face, 0)].vertex];
+    auto v1 = &_vertices[_edges[faceEdge(face, 1)].vertex];
+    auto v2 = &_vertices[_edges[faceEdge(face, 2)].vertex];
+    auto v3 = &_vertices[_edges[faceEdge(face, 3)].vertex];
+    auto n0 = ((v0->position - v1->position).getCrossed(v0->position - v3->position)).getNormalized();
+    auto n1 = ((v2->position - v3->position).getCrossed(v2->position - v1->position)).getNormalized();
+    return (n0 + n1) / 2.0;
+}
+
+// Average normal of faces around start vertex of edge, starting from
+// face of edge
+ofVec3f Quad::vertexNormal(EdgeID edge) const
+{
+    int numNormals = 0;
+    ofVec3f sumNormals = {0.0, 0.0, 0.0};
+    EdgeID e = edge;
+    do {
+        sumNormals += _faces[edgeFace(e)].normal;
+        numNormals++;
+        e = nextOutgoing(e);
+    } while (e != -1 && e != edge);
 
-    if (level > 1) {
-        return newQuad.subdivide(level - 1);
+    // Continue backwards from edge for vertices on a border
+    if (e == -1) {
+        for (e = prevOutgoing(edge); e != -1; e = prevOutgoing(e)) {
+            sumNormals += _faces[edgeFace(e)].normal;
+            numNormals++;
+        }
     }
-    return newQuad;
+    return sumNormals / numNormals;
 }
 
 // Calculate smooth normals for each vertex by averaging normal of each face
 // that vertex is a part of
-void Quad::calculateNormals()
-{
-    // Calculate normal for each pair of edges in face, and average together
-    // to get face normal. I ~think~ this should work for slightly coplanar
-    // faces.
-    for (auto &f: _faces) {
-        auto v0 = &_vertices[_edges[f.edges[0]].vertex];
-        auto v1 = &_vertices[_edges[f.edges[1]].vertex];
-        auto v2 = &_vertices[_edges[f.edges[2]].vertex];
-        auto v3 = &_vertices[_edges[f.edges[3]].vertex];
-        auto n0 = ((v0->position - v1->position).getCrossed(v0->position - v3->position)).getNormalized();
-        auto n1 = ((v2->position - v3->position).getCrossed(v2->position - v1->position)).getNormalized();
-        f.normal = (n0 + n1) / 2.0;
-    }
-    
-    // Calculate smoothed normal for each vertex
-    for (auto &edge: _edges) {
-        int numNormals = 0;
-        ofVec3f sumNormals = {0.0, 0.0, 0.0};
-        auto e = edge;
-        do {
-            sumNormals += _faces[e.face].normal;
-            numNormals++;
-            e = _edges[_edges[e.opposite].next];
-        } while (e.face != edge.face);
-        _vertices[edge.vertex].normal = sumNormals / numNormals;
+void Quad::calculateNormals(Executor *executor)
+{
+    OFXQUAD_TIME_PHASE(_stats, QuadPhase::Normals);
+    const size_t blockSize = 4096;
+
+    parallelForBlocks(executor, _faces.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto face = begin; face < end; face++) {
+            _faces[face].normal = faceNormal(face);
+        }
+    });
+
+    // Calculate smoothed normal for each vertex, once per vertex
+    parallelForBlocks(executor, _edges.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto edge = begin; edge < end; edge++) {
+            if (ownsVertex(edge)) {
+                _vertices[_edges[edge].vertex].normal = vertexNormal(edge);
+            }
+        }
+    });
+
+    _normalsValid = true;
+}
+
+// Buffers that are already out of date are left for full rebuild.
+// Moved vertices are a subset of vertices with recalculated normals.
+// Only patched render vertices are uploaded.
+void Quad::patchDrawing(const vector<VertexID> &vertices, const vector<FaceID> &faces)
+{
+    vector<size_t> dirty;
+    if (!_redrawMesh) {
+        auto &positions = _mesh.getVertices();
+        auto &normals = _mesh.getNormals();
+        patchRenderBuffer(_meshSmoothShading, vertices, faces, positions.data(), normals.data());
+        if (_meshSmoothShading) {
+            dirty.assign(vertices.begin(), vertices.end());
+        }
+        else {
+            for (auto face: faces) {
+                for (int corner = 0; corner < 4; corner++) {
+                    dirty.push_back(4 * size_t(face) + corner);
+                }
+            }
+        }
+        uploadVertices(_mesh, dirty, true);
+    }
+    if (!_redrawWireframe) {
+        auto &positions = _wireframe.getVertices();
+        for (auto v: vertices) {
+            positions[v] = _vertices[v].position;
+        }
+        dirty.assign(vertices.begin(), vertices.end());
+        uploadVertices(_wireframe, dirty, false);
+    }
+}
+
+// Limit position and normal of start vertex of edge. Limit position is
+//
+//     (n^2 P + 4 sum(e_i) + sum(d_i)) / (n (n + 5))
+//
+// where n is valence, e_i are neighbors across edges and d_i are
+// diagonal corners of faces around vertex. Normal is cross product of the
+// two limit tangents, which weight e_i and d_i by cosines and sines of
+// their angle around vertex.
+bool Quad::limitPoint(EdgeID edge, ofVec3f &position, ofVec3f &normal) const
+{
+    int valence = 0;
+    EdgeID e = edge;
+    do {
+        valence++;
+        e = nextOutgoing(e);
+        if (e == -1) {
+            return false;
+        }
+    } while (e != edge);
+
+    const double angle = TWO_PI / valence;
+    float edgeWeight = 1.0 + cos(angle) + cos(angle / 2) * sqrt(2.0 * (9.0 + cos(angle)));
+
+    ofVec3f sumEdges = {0.0, 0.0, 0.0};
+    ofVec3f sumDiagonals = {0.0, 0.0, 0.0};
+    ofVec3f tangent0 = {0.0, 0.0, 0.0};
+    ofVec3f tangent1 = {0.0, 0.0, 0.0};
+    int i = 0;
+    do {
+        // Face of e lies between neighbor i and neighbor i - 1
+        auto &neighbor = _vertices[_edges[nextEdge(e)].vertex].position;
+        auto &diagonal = _vertices[_edges[nextEdge(nextEdge(e))].vertex].position;
+        float cos0 = cos(angle * i);
+        float sin0 = sin(angle * i);
+        float cos1 = cos(angle * (i - 1));
+        float sin1 = sin(angle * (i - 1));
+
+        sumEdges += neighbor;
+        sumDiagonals += diagonal;
+        tangent0 += neighbor * (edgeWeight * cos0) + diagonal * (cos0 + cos1);
+        tangent1 += neighbor * (edgeWeight * sin0) + diagonal * (sin0 + sin1);
+
+        i++;
+        e = nextEdge(_edges[e].opposite);
+    } while (e != edge);
+
+    auto &center = _vertices[_edges[edge].vertex].position;
+    float n = valence;
+    position = (center * (n * n) + sumEdges * 4.0f + sumDiagonals) / (n * (n + 5.0f));
+
+    // Neighbors go clockwise seen from outside, so tangent1 x tangent0
+    // points outwards
+    normal = tangent1.getCrossed(tangent0).getNormalized();
+    return true;
+}
+
+void Quad::projectToLimit(Executor *executor)
+{
+    const size_t blockSize = 4096;
+
+    // Limit points are calculated from current positions, so they can't
+    // be written back until all are done
+    vector<ofVec3f> positions(_vertices.size());
+    parallelForBlocks(executor, _vertices.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto v = begin; v < end; v++) {
+            positions[v] = _vertices[v].position;
+        }
+    });
+    parallelForBlocks(executor, _edges.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto edge = begin; edge < end; edge++) {
+            if (ownsVertex(edge)) {
+                auto v = _edges[edge].vertex;
+                limitPoint(edge, positions[v], _vertices[v].normal);
+            }
+        }
+    });
+    parallelForBlocks(executor, _vertices.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto v = begin; v < end; v++) {
+            _vertices[v].position = positions[v];
+        }
+    });
+
+    // Flat shading still uses face normals of projected faces
+    parallelForBlocks(executor, _faces.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto face = begin; face < end; face++) {
+            _faces[face].normal = faceNormal(face);
+        }
+    });
+
+    // Vertices on a border have no limit point here; they keep their
+    // position and get an averaged normal
+    for (size_t edge = 0; edge < _edges.size(); edge++) {
+        if (_edges[edge].opposite == -1) {
+            _vertices[_edges[edge].vertex].normal = vertexNormal(edge);
+        }
     }
+
+    meshChanged();
+    _normalsValid = true;
+}
+
+// Mark normals and render buffers as out of date
+void Quad::meshChanged()
+{
+    _normalsValid = false;
+    _redrawMesh = true;
+    _redrawWireframe = true;
 }
@@ -2,6 +2,7 @@
 #define OFXQUAD_H
 
 #include "ofMain.h"
+#include "QuadStats.h"
 #include <vector>
 #include <array>
 #include <unordered_map>
@@ -49,42 +50,91 @@ struct Vertex
 
     // normal used for smooth shading
     ofVec3f normal;
-
-    // ID representing new vertex position
-    // when calculating subdivision surface
-    VertexID newVertex;
 };
 
+// Half-edge. Four half-edges of face f are stored as 4f..4f+3 in order
+// around face, so next half-edge and face of a half-edge are implicit
+// (see Quad::nextEdge and Quad::edgeFace).
 struct Edge
 {
     // ID representing start vertex
     VertexID vertex;
 
-    // ID representing next connected edge in face
-    EdgeID next;
-
     // ID representing mirror edge of adjacent face,
     // moving in the opposite direction
     EdgeID opposite;
+};
+
+struct Face
+{
+    // normal used for flat shading
+    ofVec3f normal;
+};
 
-    // ID representing face that this edge is a part of
-    FaceID face;
 
-    // ID representing midpoint of edge;
-    // used when calculating subdivision surface
-    VertexID midpoint;
+class Executor;
+struct PointArray;
+
+// Orders for Quad::reorder(). Vertices always follow faces: they are
+// numbered in order faces first use them, so corners of nearby faces are
+// close together in memory.
+enum class MeshOrder
+{
+    // Keep face order and only renumber vertices
+    FirstTouch,
+    // Faces along Morton (Z-order) curve through their centers
+    Morton,
+    // Faces in breadth-first order across shared edges
+    Breadth
 };
 
-struct Face
+// How Quad::subdivide() interpolates an attribute channel
+enum class AttributeRule
 {
-    std::array<EdgeID, 4> edges;
+    // Value per vertex, moved by same face, edge and vertex point rules as
+    // positions; for colors and skin weights
+    Vertex,
+    // Value per face corner (half-edge), interpolated linearly within each
+    // face, so values can differ across seams; for texture coordinates
+    FaceVarying
+};
 
-    // ID representing average of all vertices of face;
-    // mainly used for calculating subdivision surface
-    VertexID center;
+// Named float attribute of a mesh. Values are stored contiguously, width
+// floats per vertex, or per half-edge for face-varying channels.
+struct AttributeChannel
+{
+    std::string name;
+    int width;
+    AttributeRule rule;
+    std::vector<float> values;
+};
 
-    // normal used for flat shading
-    ofVec3f normal;
+// Options for Quad::subdivide. Apart from limitSurface and reorder,
+// subdivided mesh is identical for every combination of options; they only
+// change how the work is done.
+struct SubdivideOptions
+{
+    // Executor for face, edge and vertex point loops. Null runs
+    // everything on calling thread.
+    Executor *executor = nullptr;
+
+    // Build half-edges of subdivided mesh directly from parent topology.
+    // When false, subdivided faces go through addFace() and edge hashing
+    // instead; kept for comparison benchmarks.
+    bool directTopology = true;
+
+    // Move vertices of final level onto limit surface and give them exact
+    // limit normals (see Quad::projectToLimit). Attribute channels aren't
+    // projected.
+    bool limitSurface = false;
+
+    // Reorder mesh in given order before first level (see Quad::reorder).
+    // Child faces of a face are next to each other, so face order carries
+    // over to every level; vertices of final level are numbered in order
+    // faces first use them. Surface is the same, but IDs no longer follow
+    // face, edge and vertex point layout.
+    bool reorder = false;
+    MeshOrder order = MeshOrder::Morton;
 };
 
 
@@ -98,35 +148,278 @@ public:
 
     // Create quad from OBJ file
     Quad(std::string objFilename);
+
+    // Copying duplicates mesh data, edge map and draw buffers; moving
+    // doesn't copy anything
+    Quad(const Quad &) = default;
+    Quad(Quad &&) = default;
+    Quad &operator=(const Quad &) = default;
+    Quad &operator=(Quad &&) = default;
     
-    // Load mesh data from OBJ file
-    void load(std::string objFilename);
+    // Load mesh data from OBJ file at given path. Executor parses large
+    // files in parallel chunks. Throws std::runtime_error if file can't be
+    // read or isn't a valid quad mesh.
+    void load(std::string objFilename, Executor *executor=nullptr);
 
     // Add vertex and return ID of new vertex
     VertexID addVertex(ofVec3f vertex);
 
+    // Move existing vertex. Topology is left untouched.
+    void setVertex(VertexID vertex, ofVec3f position);
+    ofVec3f getVertex(VertexID vertex) const;
+
+    // Copy vertex positions and normals into structure-of-arrays storage,
+    // e.g. for kernels or GPU buffers that want separate x, y and z arrays.
+    // Normals are only meaningful after calculateNormals().
+    void getPoints(PointArray &positions, PointArray &normals,
+                   Executor *executor=nullptr) const;
+
+    std::size_t getNumVertices() const;
+    std::size_t getNumFaces() const;
+
+    // Bytes of heap memory held by mesh data, edge map and CPU side of draw
+    // buffers. Memory of uploaded GPU buffers isn't included.
+    std::size_t getMemoryUsage() const;
+
+    // Phase times and counters collected since construction or last
+    // resetStats(), and bytes currently held by each part of mesh. Times
+    // and counters stay zero unless built with OFXQUAD_STATS=1. Work done
+    // by subdivide() is counted in the returned mesh.
+    QuadStats getStats() const;
+    void resetStats();
+
     // Add vertexIDs for new face. Adjacent edges should share vertices.
     FaceID addFace(VertexID v0, VertexID v1, VertexID v2, VertexID v3);
 
-    // Catmull-Clark subdivision surface
-    Quad subdivide(int level=1);
+    // Add many faces at once and return ID of first new face. Opposite
+    // half-edges are paired by sorting instead of edge map lookups, which
+    // is much faster than calling addFace() for each face. Throws
+    // std::invalid_argument, leaving mesh unchanged, if a vertex ID isn't
+    // a vertex of mesh.
+    FaceID addFaces(const std::array<VertexID, 4> *faces, std::size_t numFaces);
+    FaceID addFaces(const std::vector<std::array<VertexID, 4>> &faces);
+
+    // Add attribute channel with all values zero, and return its index.
+    // Channels grow with vertices and faces, and are carried through
+    // subdivide(), subdivideInPlace(), reorder() and QuadBatch.
+    // QuadCache::write() rejects meshes with channels, and streaming and
+    // adaptive subdivision drop them. Throws std::invalid_argument if
+    // width isn't positive or name is taken.
+    std::size_t addAttribute(const std::string &name, int width,
+                             AttributeRule rule=AttributeRule::Vertex);
+    std::size_t getNumAttributes() const;
+
+    // Index of channel with given name, or -1
+    int findAttribute(const std::string &name) const;
+
+    // Values may be changed in place, but not resized. These throw
+    // std::out_of_range for invalid channel.
+    void removeAttribute(std::size_t channel);
+    AttributeChannel &getAttribute(std::size_t channel);
+    const AttributeChannel &getAttribute(std::size_t channel) const;
+
+    // Free memory held by edge map. Map is rebuilt if addFace() is
+    // called again.
+    void releaseEdgeMap();
+
+    // Renumber faces, their half-edges and vertices for cache locality of
+    // loops that walk faces and their neighborhoods, and of drawing.
+    // Vertices that aren't part of any face go last. Changes all IDs.
+    void reorder(MeshOrder order);
+
+    // Catmull-Clark subdivision surface. Vertex IDs of subdivided mesh are
+    // laid out as one face point per face, one edge point per edge and
+    // one vertex point per vertex, in that order. Mesh must be closed:
+    // throws std::invalid_argument if level is positive and mesh has
+    // border edges, or if level is negative.
+    Quad subdivide(int level=1) const;
+    Quad subdivide(int level, const SubdivideOptions &options) const;
+
+    // Replace mesh with its subdivision, with same result as subdivide().
+    // Levels alternate between arrays of this mesh and one set of scratch
+    // arrays, each reserved once for largest level it holds, and earlier
+    // levels are released as soon as next one is built. Faces of last
+    // level, which only hold normals, are allocated after level before it
+    // is freed. Throws std::invalid_argument if level is negative, or
+    // positive for a mesh that isn't closed.
+    void subdivideInPlace(int level=1, const SubdivideOptions &options=SubdivideOptions());
+
+    // Calculate flat shading normal of each face and smooth shading
+    // normal of each vertex, each exactly once. Called by draw() when mesh
+    // has changed. See NormalEngine for updating part of mesh.
+    void calculateNormals(Executor *executor=nullptr);
+
+    // Number of positions and normals, and number of triangle indices,
+    // written by fillRenderBuffer(). Smooth shading shares one render
+    // vertex per mesh vertex; flat shading gives each face its own four.
+    void getRenderBufferSize(bool smoothShading, std::size_t &numVertices,
+                             std::size_t &numIndices) const;
+
+    // Write triangulated mesh into caller-allocated arrays sized by
+    // getRenderBufferSize(), using normals from last calculateNormals().
+    // Doesn't use OpenGL. Throws std::overflow_error if vertex IDs don't
+    // fit ofIndexType.
+    void fillRenderBuffer(bool smoothShading, ofVec3f *positions, ofVec3f *normals,
+                          ofIndexType *indices, Executor *executor=nullptr) const;
+
+    // Write width floats of attribute channel per render vertex of buffer
+    // filled by fillRenderBuffer(). Smooth shading shares render vertices
+    // between faces, so face-varying channels take value of one corner of
+    // each vertex there; seams need flat shading. Throws
+    // std::out_of_range for invalid channel.
+    void fillAttributeBuffer(bool smoothShading, std::size_t channel, float *values,
+                             Executor *executor=nullptr) const;
+
+    // Move every vertex to its position on Catmull-Clark limit surface and
+    // set its normal to exact limit surface normal, replacing normals from
+    // calculateNormals(). Coarse meshes look as smooth as meshes that are
+    // subdivided a few more times. Vertices on borders aren't moved.
+    void projectToLimit(Executor *executor=nullptr);
+
+    // Rewrite entries of given vertices (smooth shading) or faces (flat
+    // shading) in buffers filled by fillRenderBuffer(). Indices don't
+    // change.
+    void patchRenderBuffer(bool smoothShading, const std::vector<VertexID> &vertices,
+                           const std::vector<FaceID> &faces, ofVec3f *positions,
+                           ofVec3f *normals) const;
+
+    // Number of line indices written by fillWireframeIndices()
+    std::size_t getWireframeIndexCount() const;
+
+    // Write pair of vertex IDs for each edge of mesh into caller-allocated
+    // array. Shared edges appear once. Doesn't use OpenGL.
+    void fillWireframeIndices(ofIndexType *indices) const;
 
     void draw(bool smoothShading=true);
     void drawWireframe();
 
+    // Navigation of implicit half-edge layout
+    static EdgeID faceEdge(FaceID face, int corner) { return 4 * face + corner; }
+    static FaceID edgeFace(EdgeID edge) { return edge >> 2; }
+    static EdgeID nextEdge(EdgeID edge) { return (edge & ~3) | ((edge + 1) & 3); }
+    static EdgeID prevEdge(EdgeID edge) { return (edge & ~3) | ((edge + 3) & 3); }
+
 private:
+    friend class SubdivisionPlan;
+    friend class QuadCache;
+    friend class NormalEngine;
+    friend class SubdivisionHierarchy;
+    friend class AdaptiveSubdivision;
+    friend class StreamingSubdivision;
+    friend class QuadBatch;
+    friend class QuadBvh;
+
     std::vector<Vertex> _vertices;
     std::vector<Edge> _edges;
     std::vector<Face> _faces;
+    // Half-edges that don't have an opposite half-edge yet, keyed by
+    // endpoints. Entries are removed once edges are paired, so map of a
+    // closed mesh is empty.
     std::unordered_map<EdgeKey, EdgeID, EdgeHash> _edgeMap;
+    std::vector<AttributeChannel> _attributes;
+
+    // Edge map is only built when needed by addFace(); meshes built by
+    // addFaces() or subdivide() don't have one until then
+    bool _edgeMapValid;
+    void buildEdgeMap();
 
-    EdgeID addEdge(VertexID v0, VertexID v1, FaceID f0, FaceID f1);
     EdgeID findEdge(VertexID v0, VertexID v1);
 
+    // Vertex ID of edge point in subdivided mesh for each half-edge
+    std::vector<VertexID> edgePoints(Executor *executor, std::size_t &numEdgePoints) const;
+    void edgePoints(Executor *executor, std::vector<VertexID> &midpoints,
+                    std::size_t &numEdgePoints) const;
+
+    // Exchange vertices, half-edges, faces, edge map and attribute values
+    // with other mesh
+    void swapMeshData(Quad &other);
+
+    // Move face newToOld[i] to ID i, together with its half-edges
+    void permuteFaces(const std::vector<FaceID> &newToOld);
+    // Number vertices in order half-edges first use them, and drop edge
+    // map
+    void renumberVertices();
+
+    // New positions of face, edge and vertex points. Edge and vertex points
+    // read face points, indexed by face ID, from facePoints.
+    ofVec3f facePoint(FaceID face) const;
+    ofVec3f edgePoint(EdgeID edge, const Vertex *facePoints) const;
+    ofVec3f vertexPoint(EdgeID edge, const Vertex *facePoints) const;
+    // Same point for a vertex known to have given valence, with one-ring
+    // walk unrolled and weights folded into constants
+    template <int valence>
+    ofVec3f vertexPoint(EdgeID edge, const Vertex *facePoints) const;
+
+    // Half-edges that own a vertex (see ownsVertex()), in batches of
+    // regular vertices (valence 4) and all others. Vertices that aren't
+    // part of any face are in neither.
+    struct VertexClasses
+    {
+        std::vector<EdgeID> regular;
+        std::vector<EdgeID> extraordinary;
+    };
+    // Classify vertices by walking their one-rings
+    void classifyVertices(Executor *executor, VertexClasses &classes) const;
+    // Classes of subdivided mesh, derived from classes of this mesh
+    // without walking one-rings. Mesh must be closed: then face and edge
+    // points are regular, and vertex points keep valence of their vertex.
+    void childVertexClasses(const std::vector<VertexID> &edgePoints, std::size_t numEdgePoints,
+                            const VertexClasses &classes, VertexClasses &childClasses,
+                            Executor *executor) const;
+
+    // Write positions of face, edge and vertex points into child vertices
+    void subdividePoints(Quad &child, const std::vector<VertexID> &edgePoints,
+                         const VertexClasses &classes, Executor *executor) const;
+
+    void buildChildTopology(Quad &child, const std::vector<VertexID> &edgePoints,
+                            Executor *executor) const;
+    void addChildFaces(Quad &child, const std::vector<VertexID> &edgePoints) const;
+
+    // Resize attribute values to match vertices and half-edges, filling
+    // new ones with zeros
+    void resizeAttributes();
+    // Write attribute values of child vertices and corners; child must have
+    // same channels, and its vertices must be sized
+    void subdivideAttributes(Quad &child, const std::vector<VertexID> &edgePoints,
+                             const VertexClasses &classes, Executor *executor) const;
+
+    // Next and previous outgoing half-edge around start vertex of edge, or
+    // -1 at a border
+    EdgeID nextOutgoing(EdgeID edge) const
+    {
+        auto opposite = _edges[edge].opposite;
+        return opposite == -1 ? -1 : nextEdge(opposite);
+    }
+    EdgeID prevOutgoing(EdgeID edge) const { return _edges[prevEdge(edge)].opposite; }
+
+    bool ownsVertex(EdgeID edge) const;
+    ofVec3f faceNormal(FaceID face) const;
+    ofVec3f vertexNormal(EdgeID edge) const;
+    // False if vertex is on a border, which has no limit point here
+    bool limitPoint(EdgeID edge, ofVec3f &position, ofVec3f &normal) const;
+
+    // Normals match current positions
+    bool _normalsValid;
+
+    // Called whenever positions or topology change
+    void meshChanged();
+
+    // Update existing draw buffers after given vertices moved and their
+    // normals, and those of given faces, were recalculated. Only
+    // changed entries are uploaded.
+    void patchDrawing(const std::vector<VertexID> &vertices, const std::vector<FaceID> &faces);
+
     ofVboMesh _mesh;
     bool _redrawMesh;
+    // Shading that _mesh was built for
+    bool _meshSmoothShading;
+
+    // Line mesh drawn by drawWireframe(); rebuilt with _mesh
+    ofVboMesh _wireframe;
+    bool _redrawWireframe;
 
-    void calculateNormals();
+    // Times and counters; byte counts are filled in by getStats()
+    QuadStats _stats;
 };
 
 };
@@ -0,0 +1,213 @@
+#include "QuadBatch.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+
+
+QuadBatch::QuadBatch() : _numIndices(0), _redraw(true), _smoothShading(true)
+{
+
+}
+
+void QuadBatch::reserve(size_t numVertices, size_t numFaces)
+{
+    _quad._vertices.reserve(numVertices);
+    _quad._edges.reserve(4 * numFaces);
+    _quad._faces.reserve(numFaces);
+}
+
+// First mesh sets attribute channels of batch, and others must match them,
+// so that values of every mesh can be packed into one array per channel
+size_t QuadBatch::add(const Quad &quad)
+{
+    auto &channels = _quad._attributes;
+    if (_ranges.empty()) {
+        channels.clear();
+        for (auto &channel: quad._attributes) {
+            channels.push_back({channel.name, channel.width, channel.rule, {}});
+        }
+        _quad.resizeAttributes();
+    }
+    else {
+        bool match = channels.size() == quad._attributes.size();
+        for (size_t c = 0; match && c < channels.size(); c++) {
+            auto &channel = quad._attributes[c];
+            match = channels[c].name == channel.name && channels[c].width == channel.width &&
+                    channels[c].rule == channel.rule;
+        }
+        if (!match) {
+            throw invalid_argument("meshes of a batch must have same attribute channels");
+        }
+    }
+
+    MeshRange range;
+    range.firstFace = _quad._faces.size();
+    range.numFaces = quad._faces.size();
+
+    append(_quad, quad);
+    _quad.meshChanged();
+    _ranges.push_back(range);
+    _redraw = true;
+    return _ranges.size() - 1;
+}
+
+// Half-edges are copied with their vertex and opposite IDs offset, so
+// target needs no edge pairing. Source must have same attribute channels
+// as target.
+void QuadBatch::append(Quad &target, const Quad &source)
+{
+    if (target._vertices.size() + source._vertices.size() > size_t(numeric_limits<VertexID>::max()) ||
+        target._edges.size() + source._edges.size() > size_t(numeric_limits<EdgeID>::max())) {
+        throw overflow_error("Too many vertices or faces for one batch");
+    }
+
+    VertexID vertexOffset = target._vertices.size();
+    EdgeID edgeOffset = target._edges.size();
+    target._vertices.insert(target._vertices.end(), source._vertices.begin(), source._vertices.end());
+    target._faces.insert(target._faces.end(), source._faces.begin(), source._faces.end());
+
+    auto numEdges = source._edges.size();
+    target._edges.resize(target._edges.size() + numEdges);
+    auto edges = target._edges.data() + edgeOffset;
+    for (size_t e = 0; e < numEdges; e++) {
+        auto &edge = source._edges[e];
+        edges[e].vertex = edge.vertex + vertexOffset;
+        edges[e].opposite = edge.opposite == -1 ? -1 : edge.opposite + edgeOffset;
+    }
+
+    for (size_t c = 0; c < target._attributes.size(); c++) {
+        auto &values = source._attributes[c].values;
+        target._attributes[c].values.insert(target._attributes[c].values.end(), values.begin(),
+                                            values.end());
+    }
+
+    target._edgeMap.clear();
+    target._edgeMapValid = false;
+}
+
+size_t QuadBatch::getNumMeshes() const
+{
+    return _ranges.size();
+}
+
+const QuadBatch::MeshRange &QuadBatch::getRange(size_t mesh) const
+{
+    return _ranges.at(mesh);
+}
+
+const Quad &QuadBatch::getQuad() const
+{
+    return _quad;
+}
+
+void QuadBatch::getBounds(size_t mesh, ofVec3f &min, ofVec3f &max) const
+{
+    auto &range = _ranges.at(mesh);
+    min = max = {0.0, 0.0, 0.0};
+    auto firstEdge = Quad::faceEdge(range.firstFace, 0);
+    for (size_t e = 0; e < 4 * range.numFaces; e++) {
+        auto &p = _quad._vertices[_quad._edges[firstEdge + e].vertex].position;
+        if (e == 0) {
+            min = max = p;
+        }
+        for (int k = 0; k < 3; k++) {
+            min[k] = std::min(min[k], p[k]);
+            max[k] = std::max(max[k], p[k]);
+        }
+    }
+}
+
+// Child faces of face f are 4f to 4f + 3, so subdividing packed mesh as a
+// whole keeps faces of each mesh consecutive, with ranges scaled by 4 per
+// level
+QuadBatch QuadBatch::subdivide(int level, const SubdivideOptions &options) const
+{
+    if (level < 0) {
+        throw invalid_argument("subdivision level must not be negative");
+    }
+    if (options.reorder) {
+        throw invalid_argument("meshes of a batch can't be reordered");
+    }
+    size_t scale = size_t(1) << (2 * level);
+    if (_quad._edges.size() > size_t(numeric_limits<EdgeID>::max()) / scale) {
+        throw overflow_error("Too many faces for one batch");
+    }
+
+    QuadBatch batch;
+    batch._quad = _quad.subdivide(level, options);
+    if (!batch._quad._normalsValid) {
+        batch._quad.calculateNormals(options.executor);
+    }
+    batch._ranges = _ranges;
+    for (auto &range: batch._ranges) {
+        range.firstFace *= scale;
+        range.numFaces *= scale;
+    }
+    return batch;
+}
+
+void QuadBatch::draw(bool smoothShading)
+{
+    updateBuffers(smoothShading);
+    if (_numIndices > 0) {
+        _vbo.drawElements(GL_TRIANGLES, _numIndices);
+    }
+}
+
+// Ranges of meshes follow mesh order, so sorted meshes give ranges in
+// buffer order, and touching ranges are merged
+void QuadBatch::draw(const vector<size_t> &meshes, bool smoothShading)
+{
+    auto sorted = meshes;
+    sort(sorted.begin(), sorted.end());
+    updateBuffers(smoothShading);
+
+    size_t begin = 0;
+    size_t end = 0;
+    for (auto mesh: sorted) {
+        auto &range = _ranges.at(mesh);
+        size_t first = 6 * size_t(range.firstFace);
+        if (first < end) {
+            continue;
+        }
+        if (first != end) {
+            if (end > begin) {
+                _vbo.drawElements(GL_TRIANGLES, end - begin, begin);
+            }
+            begin = first;
+        }
+        end = first + 6 * range.numFaces;
+    }
+    if (end > begin) {
+        _vbo.drawElements(GL_TRIANGLES, end - begin, begin);
+    }
+}
+
+// Render buffer of packed mesh is uploaded once; it is only rebuilt when
+// meshes are added or shading changes
+void QuadBatch::updateBuffers(bool smoothShading)
+{
+    if (!_redraw && smoothShading == _smoothShading) {
+        return;
+    }
+    if (!_quad._normalsValid) {
+        _quad.calculateNormals();
+    }
+
+    size_t numVertices;
+    _quad.getRenderBufferSize(smoothShading, numVertices, _numIndices);
+    vector<ofVec3f> positions(numVertices);
+    vector<ofVec3f> normals(numVertices);
+    vector<ofIndexType> indices(_numIndices);
+    _quad.fillRenderBuffer(smoothShading, positions.data(), normals.data(), indices.data());
+
+    _vbo.setVertexData(positions.data(), numVertices, GL_STATIC_DRAW);
+    _vbo.setNormalData(normals.data(), numVertices, GL_STATIC_DRAW);
+    _vbo.setIndexData(indices.data(), _numIndices, GL_STATIC_DRAW);
+
+    _redraw = false;
+    _smoothShading = smoothShading;
+}
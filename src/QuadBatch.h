@@ -0,0 +1,87 @@
+#ifndef OFXQUAD_QUADBATCH_H
+#define OFXQUAD_QUADBATCH_H
+
+#include "Quad.h"
+#include <vector>
+#include <cstddef>
+
+
+namespace ofx
+{
+
+// Many meshes packed into the arrays of a single Quad, so that they are
+// subdivided in one pass and drawn from one vertex buffer with one draw
+// call, or one call per run of consecutive meshes. Meshes don't share
+// vertices or edges, so the packed mesh is just their union.
+class QuadBatch
+{
+public:
+    // Faces of packed mesh holding one mesh. In render buffer, triangle
+    // indices of face f are 6f to 6f + 5. Child faces of face f are 4f to
+    // 4f + 3, so ranges scale by 4 with each subdivided level.
+    struct MeshRange
+    {
+        FaceID firstFace;
+        std::size_t numFaces;
+    };
+
+    QuadBatch();
+
+    // Reserve room for meshes with given totals, to avoid regrowing packed
+    // arrays while adding many meshes
+    void reserve(std::size_t numVertices, std::size_t numFaces);
+
+    // Copy mesh, with its attribute channels, into batch and return its
+    // index. First mesh sets channels of batch. Throws
+    // std::invalid_argument if mesh has other channel names, widths or
+    // rules than first mesh, and std::overflow_error if packed IDs don't
+    // fit VertexID and EdgeID.
+    std::size_t add(const Quad &quad);
+
+    std::size_t getNumMeshes() const;
+    const MeshRange &getRange(std::size_t mesh) const;
+
+    // Packed mesh
+    const Quad &getQuad() const;
+
+    // Bounding box of corners of faces of a mesh, for culling. Meshes
+    // without faces get an empty box at origin.
+    void getBounds(std::size_t mesh, ofVec3f &min, ofVec3f &max) const;
+
+    // Subdivide packed mesh as a whole, in parallel on options.executor,
+    // and calculate its normals. Faces of each mesh stay consecutive.
+    // Single threaded, this is slower than subdividing meshes one by one,
+    // whose working memory stays in cache (see README).
+    // Throws std::invalid_argument if level is negative, a mesh isn't
+    // closed or options.reorder is set, since reordering would mix meshes,
+    // and std::overflow_error if subdivided IDs wouldn't fit EdgeID.
+    QuadBatch subdivide(int level=1, const SubdivideOptions &options=SubdivideOptions()) const;
+
+    // Draw all meshes with one call
+    void draw(bool smoothShading=true);
+
+    // Draw given meshes, such as those that passed culling. Meshes with
+    // consecutive ranges are drawn with one call. Throws std::out_of_range
+    // for invalid mesh indices.
+    void draw(const std::vector<std::size_t> &meshes, bool smoothShading=true);
+
+private:
+    Quad _quad;
+    std::vector<MeshRange> _ranges;
+
+    ofVbo _vbo;
+    std::size_t _numIndices;
+    bool _redraw;
+    // Shading that _vbo was built for
+    bool _smoothShading;
+
+    void updateBuffers(bool smoothShading);
+
+    // Copy vertices and faces of source to end of target
+    static void append(Quad &target, const Quad &source);
+};
+
+};
+
+
+#endif
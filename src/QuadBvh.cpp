@@ -0,0 +1,537 @@
+#include "QuadBvh.h"
+#include "Executor.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+
+
+namespace
+{
+
+const int numBins = 16;
+const size_t maxLeafFaces = 4;
+
+// Below this depth nodes are split at median instead of by surface area,
+// which halves face count of each level. FaceID has 31 bits, so no path is
+// longer than traversal stack.
+const int maxSahDepth = 32;
+const int stackSize = 64;
+
+// Smallest subtree built as a separate task
+const size_t minSubtreeFaces = 4096;
+
+const float infinity = numeric_limits<float>::infinity();
+
+void grow(ofVec3f &min, ofVec3f &max, const ofVec3f &point)
+{
+    for (int i = 0; i < 3; i++) {
+        min[i] = std::min(min[i], point[i]);
+        max[i] = std::max(max[i], point[i]);
+    }
+}
+
+float surfaceArea(const ofVec3f &min, const ofVec3f &max)
+{
+    auto size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+array<ofVec3f, 4> corners(const vector<Vertex> &vertices, const vector<Edge> &edges, FaceID face)
+{
+    return {{vertices[edges[Quad::faceEdge(face, 0)].vertex].position,
+             vertices[edges[Quad::faceEdge(face, 1)].vertex].position,
+             vertices[edges[Quad::faceEdge(face, 2)].vertex].position,
+             vertices[edges[Quad::faceEdge(face, 3)].vertex].position}};
+}
+
+// Ray parameter where ray enters box, or infinity if it misses box or
+// enters it beyond maxT
+float enterBox(const ofVec3f &min, const ofVec3f &max, const ofVec3f &origin,
+               const ofVec3f &inverseDirection, float maxT)
+{
+    float enter = 0.0;
+    float exit = maxT;
+    for (int i = 0; i < 3; i++) {
+        float t0 = (min[i] - origin[i]) * inverseDirection[i];
+        float t1 = (max[i] - origin[i]) * inverseDirection[i];
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return enter <= exit ? enter : infinity;
+}
+
+float squaredDistanceToBox(const ofVec3f &min, const ofVec3f &max, const ofVec3f &point)
+{
+    float distance = 0.0;
+    for (int i = 0; i < 3; i++) {
+        float d = std::max(std::max(min[i] - point[i], point[i] - max[i]), 0.0f);
+        distance += d * d;
+    }
+    return distance;
+}
+
+// Ray against bilinear patch p0, p1, p2, p3 (Reshetov, "Cool Patches",
+// Ray Tracing Gems, 2019). Solves a quadratic in u and keeps nearest root
+// with 0 < t < maxT and u and v inside patch.
+bool intersectPatch(const array<ofVec3f, 4> &p, const ofVec3f &origin, const ofVec3f &direction,
+                    float maxT, float &t, float &u, float &v)
+{
+    auto q00 = p[0] - origin;
+    auto q10 = p[1] - origin;
+    auto e00 = p[3] - p[0];
+    auto e11 = p[2] - p[1];
+    auto normal = (p[1] - p[0]).getCrossed(p[3] - p[2]);
+
+    float a = q00.getCrossed(direction).dot(e00);
+    float c = normal.dot(direction);
+    float b = q10.getCrossed(direction).dot(e11) - a - c;
+    float det = b * b - 4 * a * c;
+    if (det < 0) {
+        return false;
+    }
+    det = sqrt(det);
+
+    float roots[2];
+    if (c == 0) {
+        roots[0] = -a / b;
+        roots[1] = -1;
+    }
+    else {
+        roots[0] = (-b - copysign(det, b)) / 2;
+        roots[1] = a / roots[0];
+        roots[0] /= c;
+    }
+
+    bool hit = false;
+    for (auto root: roots) {
+        if (!(root >= 0 && root <= 1)) {
+            continue;
+        }
+        auto pa = q00 + (q10 - q00) * root;
+        auto pb = e00 + (e11 - e00) * root;
+        auto n = direction.getCrossed(pb);
+        float length = n.dot(n);
+        n = n.getCrossed(pa);
+        float rootT = n.dot(pb) / length;
+        float rootV = n.dot(direction);
+        if (rootT > 0 && rootT < maxT && rootV >= 0 && rootV <= length) {
+            t = maxT = rootT;
+            u = root;
+            v = rootV / length;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+// Closest point of triangle a, b, c to p (Ericson, "Real-Time Collision
+// Detection", 5.1.5)
+ofVec3f closestOnTriangle(const ofVec3f &p, const ofVec3f &a, const ofVec3f &b, const ofVec3f &c)
+{
+    auto ab = b - a;
+    auto ac = c - a;
+    auto ap = p - a;
+    float d1 = ab.dot(ap);
+    float d2 = ac.dot(ap);
+    if (d1 <= 0 && d2 <= 0) {
+        return a;
+    }
+    auto bp = p - b;
+    float d3 = ab.dot(bp);
+    float d4 = ac.dot(bp);
+    if (d3 >= 0 && d4 <= d3) {
+        return b;
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+    auto cp = p - c;
+    float d5 = ab.dot(cp);
+    float d6 = ac.dot(cp);
+    if (d6 >= 0 && d5 <= d6) {
+        return c;
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    float denominator = 1 / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+};
+
+
+struct QuadBvh::Builder
+{
+    vector<ofVec3f> mins;
+    vector<ofVec3f> maxes;
+    vector<ofVec3f> centroids;
+
+    // While set, nodes with at most subtreeFaces faces are left as
+    // subtrees, which are built in parallel with an executor
+    bool deferSubtrees;
+    size_t subtreeFaces;
+
+    struct Subtree
+    {
+        size_t node;
+        size_t first;
+        size_t count;
+        int depth;
+    };
+    vector<Subtree> subtrees;
+};
+
+QuadBvh::QuadBvh(const Quad &quad, Executor *executor)
+{
+    const size_t blockSize = 4096;
+    auto numFaces = quad._faces.size();
+    if (numFaces == 0) {
+        return;
+    }
+
+    Builder builder;
+    builder.mins.resize(numFaces);
+    builder.maxes.resize(numFaces);
+    builder.centroids.resize(numFaces);
+    parallelForBlocks(executor, numFaces, blockSize, [&](size_t begin, size_t end) {
+        for (auto face = begin; face < end; face++) {
+            auto p = corners(quad._vertices, quad._edges, face);
+            auto &min = builder.mins[face];
+            auto &max = builder.maxes[face];
+            min = max = p[0];
+            for (int i = 1; i < 4; i++) {
+                grow(min, max, p[i]);
+            }
+            builder.centroids[face] = (min + max) / 2;
+        }
+    });
+
+    _faces.resize(numFaces);
+    for (size_t face = 0; face < numFaces; face++) {
+        _faces[face] = face;
+    }
+    // Every split makes two nodes, and leaves hold at least one face
+    _nodes.reserve(2 * numFaces - 1);
+    _nodes.push_back(Node());
+    builder.deferSubtrees = true;
+    builder.subtreeFaces = std::max(numFaces / 64, minSubtreeFaces);
+    build(builder, _nodes, 0, 0, numFaces, 0);
+    builder.deferSubtrees = false;
+
+    // Subtrees are built into their own arrays, and appended in order, so
+    // node layout doesn't depend on scheduling. Root of each subtree
+    // replaces node it was deferred from.
+    auto &subtrees = builder.subtrees;
+    vector<vector<Node>> subtreeNodes(subtrees.size());
+    parallelForBlocks(executor, subtrees.size(), 1, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto &subtree = subtrees[i];
+            auto &nodes = subtreeNodes[i];
+            nodes.reserve(2 * subtree.count - 1);
+            nodes.push_back(Node());
+            build(builder, nodes, 0, subtree.first, subtree.count, subtree.depth);
+        }
+    });
+    for (size_t i = 0; i < subtrees.size(); i++) {
+        auto &nodes = subtreeNodes[i];
+        int32_t offset = int32_t(_nodes.size()) - 1;
+        for (auto &node: nodes) {
+            if (node.count == 0) {
+                node.first += offset;
+            }
+        }
+        _nodes[subtrees[i].node] = nodes[0];
+        _nodes.insert(_nodes.end(), nodes.begin() + 1, nodes.end());
+    }
+}
+
+// Faces are split along axis and bin boundary with lowest surface area
+// cost, binning faces by centroid. Without a useful split, or once deep
+// enough, faces are split at median centroid of longest axis instead.
+void QuadBvh::build(Builder &builder, vector<Node> &nodes, size_t node, size_t first, size_t count,
+                    int depth)
+{
+    if (builder.deferSubtrees && count <= builder.subtreeFaces) {
+        builder.subtrees.push_back({node, first, count, depth});
+        return;
+    }
+
+    auto faces = _faces.begin() + first;
+    ofVec3f min = builder.mins[faces[0]];
+    ofVec3f max = builder.maxes[faces[0]];
+    ofVec3f centroidMin = builder.centroids[faces[0]];
+    ofVec3f centroidMax = centroidMin;
+    for (size_t i = 1; i < count; i++) {
+        grow(min, max, builder.mins[faces[i]]);
+        grow(min, max, builder.maxes[faces[i]]);
+        grow(centroidMin, centroidMax, builder.centroids[faces[i]]);
+    }
+    nodes[node].min = min;
+    nodes[node].max = max;
+    if (count <= maxLeafFaces) {
+        nodes[node].first = first;
+        nodes[node].count = count;
+        return;
+    }
+
+    auto extent = centroidMax - centroidMin;
+    int bestAxis = 0;
+    for (int axis = 1; axis < 3; axis++) {
+        if (extent[axis] > extent[bestAxis]) {
+            bestAxis = axis;
+        }
+    }
+    int bestSplit = -1;
+    auto binOf = [&](FaceID face, int axis) {
+        int bin = (builder.centroids[face][axis] - centroidMin[axis]) * numBins / extent[axis];
+        return std::min(bin, numBins - 1);
+    };
+
+    if (depth < maxSahDepth) {
+        // Splitting is worth it if cost of children is below cost of
+        // intersecting every face of node
+        float bestCost = surfaceArea(min, max) * count;
+        for (int axis = 0; axis < 3; axis++) {
+            if (extent[axis] <= 0) {
+                continue;
+            }
+            size_t counts[numBins] = {};
+            ofVec3f binMins[numBins];
+            ofVec3f binMaxes[numBins];
+            for (size_t i = 0; i < count; i++) {
+                auto face = faces[i];
+                int bin = binOf(face, axis);
+                if (counts[bin]++ == 0) {
+                    binMins[bin] = builder.mins[face];
+                    binMaxes[bin] = builder.maxes[face];
+                }
+                else {
+                    grow(binMins[bin], binMaxes[bin], builder.mins[face]);
+                    grow(binMins[bin], binMaxes[bin], builder.maxes[face]);
+                }
+            }
+
+            // Cost of bins left of each boundary, then sweep from right
+            float leftCosts[numBins];
+            size_t leftCount = 0;
+            ofVec3f boxMin(infinity, infinity, infinity);
+            ofVec3f boxMax = -boxMin;
+            for (int bin = 0; bin < numBins - 1; bin++) {
+                if (counts[bin] > 0) {
+                    leftCount += counts[bin];
+                    grow(boxMin, boxMax, binMins[bin]);
+                    grow(boxMin, boxMax, binMaxes[bin]);
+                }
+                leftCosts[bin] = leftCount > 0 ? surfaceArea(boxMin, boxMax) * leftCount : 0;
+            }
+            size_t rightCount = 0;
+            boxMin = ofVec3f(infinity, infinity, infinity);
+            boxMax = -boxMin;
+            for (int bin = numBins - 1; bin > 0; bin--) {
+                if (counts[bin] > 0) {
+                    rightCount += counts[bin];
+                    grow(boxMin, boxMax, binMins[bin]);
+                    grow(boxMin, boxMax, binMaxes[bin]);
+                }
+                if (rightCount == 0 || rightCount == count) {
+                    continue;
+                }
+                float cost = leftCosts[bin - 1] + surfaceArea(boxMin, boxMax) * rightCount;
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = bin;
+                }
+            }
+        }
+    }
+
+    size_t leftCount;
+    if (bestSplit != -1) {
+        auto middle = partition(faces, faces + count, [&](FaceID face) {
+            return binOf(face, bestAxis) < bestSplit;
+        });
+        leftCount = middle - faces;
+    }
+    else {
+        leftCount = count / 2;
+        nth_element(faces, faces + leftCount, faces + count, [&](FaceID a, FaceID b) {
+            return builder.centroids[a][bestAxis] < builder.centroids[b][bestAxis];
+        });
+    }
+
+    auto left = nodes.size();
+    nodes[node].first = left;
+    nodes[node].count = 0;
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    build(builder, nodes, left, first, leftCount, depth + 1);
+    build(builder, nodes, left + 1, first + leftCount, count - leftCount, depth + 1);
+}
+
+// Children come after their parent, so walking nodes backwards visits
+// children first
+void QuadBvh::refit(const Quad &quad, Executor *executor)
+{
+    const size_t blockSize = 1024;
+    if (quad._faces.size() != _faces.size()) {
+        throw invalid_argument("mesh does not match hierarchy");
+    }
+
+    parallelForBlocks(executor, _nodes.size(), blockSize, [&](size_t begin, size_t end) {
+        for (auto n = begin; n < end; n++) {
+            auto &node = _nodes[n];
+            if (node.count == 0) {
+                continue;
+            }
+            for (int i = 0; i < node.count; i++) {
+                auto p = corners(quad._vertices, quad._edges, _faces[node.first + i]);
+                if (i == 0) {
+                    node.min = node.max = p[0];
+                }
+                for (auto &corner: p) {
+                    grow(node.min, node.max, corner);
+                }
+            }
+        }
+    });
+    for (size_t n = _nodes.size(); n-- > 0;) {
+        auto &node = _nodes[n];
+        if (node.count == 0) {
+            auto &left = _nodes[node.first];
+            auto &right = _nodes[node.first + 1];
+            node.min = left.min;
+            node.max = left.max;
+            grow(node.min, node.max, right.min);
+            grow(node.min, node.max, right.max);
+        }
+    }
+}
+
+// Nearer child is visited first, and nodes entered beyond nearest hit so
+// far are skipped
+bool QuadBvh::intersect(const Quad &quad, ofVec3f origin, ofVec3f direction, QuadHit &hit,
+                        float maxT) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+    ofVec3f inverseDirection(1 / direction.x, 1 / direction.y, 1 / direction.z);
+    bool found = false;
+
+    int stack[stackSize];
+    int size = 0;
+    if (enterBox(_nodes[0].min, _nodes[0].max, origin, inverseDirection, maxT) < infinity) {
+        stack[size++] = 0;
+    }
+    while (size > 0) {
+        auto &node = _nodes[stack[--size]];
+        if (enterBox(node.min, node.max, origin, inverseDirection, maxT) == infinity) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                auto face = _faces[node.first + i];
+                float t, u, v;
+                if (intersectPatch(corners(quad._vertices, quad._edges, face),
+                                   origin, direction, maxT, t, u, v)) {
+                    maxT = t;
+                    hit.face = face;
+                    hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        int near = node.first;
+        int far = node.first + 1;
+        float nearT = enterBox(_nodes[near].min, _nodes[near].max, origin, inverseDirection, maxT);
+        float farT = enterBox(_nodes[far].min, _nodes[far].max, origin, inverseDirection, maxT);
+        if (farT < nearT) {
+            swap(near, far);
+            swap(nearT, farT);
+        }
+        if (farT < infinity) {
+            stack[size++] = far;
+        }
+        if (nearT < infinity) {
+            stack[size++] = near;
+        }
+    }
+    return found;
+}
+
+bool QuadBvh::closestPoint(const Quad &quad, ofVec3f point, QuadPoint &result,
+                           float maxDistance) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+    float best = maxDistance * maxDistance;
+    bool found = false;
+
+    int stack[stackSize];
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0) {
+        auto &node = _nodes[stack[--size]];
+        if (squaredDistanceToBox(node.min, node.max, point) > best) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                auto face = _faces[node.first + i];
+                auto p = corners(quad._vertices, quad._edges, face);
+                for (auto &closest: {closestOnTriangle(point, p[0], p[1], p[2]),
+                                     closestOnTriangle(point, p[0], p[2], p[3])}) {
+                    float distance = closest.squareDistance(point);
+                    if (distance <= best) {
+                        best = distance;
+                        result.face = face;
+                        result.position = closest;
+                        found = true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        int near = node.first;
+        int far = node.first + 1;
+        float nearDistance = squaredDistanceToBox(_nodes[near].min, _nodes[near].max, point);
+        float farDistance = squaredDistanceToBox(_nodes[far].min, _nodes[far].max, point);
+        if (farDistance < nearDistance) {
+            swap(near, far);
+            swap(nearDistance, farDistance);
+        }
+        if (farDistance <= best) {
+            stack[size++] = far;
+        }
+        if (nearDistance <= best) {
+            stack[size++] = near;
+        }
+    }
+    if (found) {
+        result.distance = sqrt(best);
+    }
+    return found;
+}
+
+size_t QuadBvh::getNumNodes() const
+{
+    return _nodes.size();
+}
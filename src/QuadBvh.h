@@ -0,0 +1,96 @@
+#ifndef OFXQUAD_QUADBVH_H
+#define OFXQUAD_QUADBVH_H
+
+#include "Quad.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+
+namespace ofx
+{
+
+class Executor;
+
+// Face hit by a ray
+struct QuadHit
+{
+    FaceID face = -1;
+
+    // Ray parameter of hit, in units of ray direction
+    float t = 0.0;
+
+    // Bilinear coordinates of hit. With corners p0 to p3 in face order,
+    // hit is at (1 - v)((1 - u) p0 + u p1) + v((1 - u) p3 + u p2).
+    float u = 0.0;
+    float v = 0.0;
+};
+
+// Point of mesh closest to a query point
+struct QuadPoint
+{
+    FaceID face = -1;
+    ofVec3f position;
+    float distance = 0.0;
+};
+
+// Bounding volume hierarchy over faces of a mesh, for picking and
+// snapping against large subdivided meshes in logarithmic rather than
+// linear time. Nodes are kept in one array, children of a node next to
+// each other after it, and are split by binned surface area heuristic.
+// Hierarchy doesn't keep a reference to mesh; queries take mesh it was
+// built from, with vertices moved at most since last refit().
+class QuadBvh
+{
+public:
+    // Build hierarchy over faces of mesh. Face bounds, and subtrees below
+    // top levels, are built on executor; hierarchy is same without one.
+    QuadBvh(const Quad &quad, Executor *executor=nullptr);
+
+    // Update bounds after vertices of mesh moved, keeping hierarchy. Cost
+    // is linear, but much less than building again; queries slow down if
+    // vertices move far. Throws std::invalid_argument if number of faces
+    // changed.
+    void refit(const Quad &quad, Executor *executor=nullptr);
+
+    // Find first face hit by ray origin + t * direction for 0 < t <=
+    // maxT. Faces are intersected as bilinear patches, so hit is exact
+    // for faces that aren't planar. Returns false if no face is hit.
+    bool intersect(const Quad &quad, ofVec3f origin, ofVec3f direction, QuadHit &hit,
+                   float maxT=std::numeric_limits<float>::infinity()) const;
+
+    // Find closest point of mesh within maxDistance of point. Faces are
+    // split into same two triangles as in render buffer. Returns false if
+    // no face is that close.
+    bool closestPoint(const Quad &quad, ofVec3f point, QuadPoint &result,
+                      float maxDistance=std::numeric_limits<float>::infinity()) const;
+
+    std::size_t getNumNodes() const;
+
+private:
+    // Internal node if count is 0, with children first and first + 1.
+    // Leaf otherwise, with faces _faces[first] to _faces[first + count - 1].
+    struct Node
+    {
+        ofVec3f min;
+        ofVec3f max;
+        int32_t first;
+        int32_t count;
+    };
+
+    std::vector<Node> _nodes;
+    // Faces in leaf order
+    std::vector<FaceID> _faces;
+
+    // Face bounds and centroids, kept while building
+    struct Builder;
+    // Split faces first to first + count - 1 below given node of nodes
+    void build(Builder &builder, std::vector<Node> &nodes, std::size_t node, std::size_t first,
+               std::size_t count, int depth);
+};
+
+};
+
+
+#endif
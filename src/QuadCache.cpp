@@ -0,0 +1,270 @@
+#include "QuadCache.h"
+#include "BinaryIO.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+using namespace ofx::binary;
+
+
+namespace
+{
+
+const char magic[8] = {'o', 'f', 'x', 'Q', 'u', 'a', 'd', '\0'};
+const size_t headerSize = 16;
+const size_t levelEntrySize = 24;
+
+// Positions converted per read of level data
+const size_t vertexChunkSize = 65536;
+
+// 64-bit FNV-1a over little-endian 64-bit words, fed in pieces of any
+// size. Last word is zero padded.
+class Checksum
+{
+public:
+    Checksum() : _hash(14695981039346656037ull), _numPending(0) {}
+
+    void add(const char *data, size_t size)
+    {
+        // Complete partly filled word first
+        for (; _numPending > 0 && size > 0; data++, size--) {
+            _pending[_numPending++] = *data;
+            if (_numPending == 8) {
+                addWord(_pending);
+                _numPending = 0;
+            }
+        }
+        for (; size >= 8; data += 8, size -= 8) {
+            addWord(data);
+        }
+        for (; size > 0; data++, size--) {
+            _pending[_numPending++] = *data;
+        }
+    }
+
+    uint64_t finish()
+    {
+        if (_numPending > 0) {
+            memset(_pending + _numPending, 0, 8 - _numPending);
+            addWord(_pending);
+            _numPending = 0;
+        }
+        return _hash;
+    }
+
+private:
+    void addWord(const char *p)
+    {
+        _hash = (_hash ^ readLittle<uint64_t>(p)) * 1099511628211ull;
+    }
+
+    uint64_t _hash;
+    char _pending[8];
+    size_t _numPending;
+};
+
+size_t levelDataSize(size_t numVertices, size_t numFaces)
+{
+    return numVertices * 12 + numFaces * 4 * 8;
+}
+
+};
+
+
+QuadCache::QuadCache(const string &path) : _path(path)
+{
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw runtime_error("Could not open file: " + path);
+    }
+    input.seekg(0, ios::end);
+    uint64_t size = input.tellg();
+    input.seekg(0);
+
+    char header[headerSize];
+    if (size < headerSize || !input.read(header, headerSize) ||
+        memcmp(header, magic, sizeof(magic)) != 0) {
+        throw runtime_error("Not a quad cache file: " + path);
+    }
+    auto fileVersion = readLittle<uint32_t>(header + 8);
+    if (fileVersion != version) {
+        throw runtime_error("Unsupported quad cache version " + to_string(fileVersion) + ": " + path);
+    }
+    auto numLevels = readLittle<uint32_t>(header + 12);
+    if (numLevels > (size - headerSize) / levelEntrySize) {
+        throw runtime_error("Truncated quad cache file: " + path);
+    }
+
+    vector<char> table(numLevels * levelEntrySize);
+    if (!input.read(table.data(), table.size())) {
+        throw runtime_error("Truncated quad cache file: " + path);
+    }
+    _levels.resize(numLevels);
+    for (size_t i = 0; i < numLevels; i++) {
+        auto entry = &table[i * levelEntrySize];
+        auto &level = _levels[i];
+        level.offset = readLittle<uint64_t>(entry);
+        level.numVertices = readLittle<uint32_t>(entry + 8);
+        level.numFaces = readLittle<uint32_t>(entry + 12);
+        level.checksum = readLittle<uint64_t>(entry + 16);
+
+        if (level.numFaces > uint32_t(INT32_MAX / 4) || level.offset > size ||
+            levelDataSize(level.numVertices, level.numFaces) > size - level.offset) {
+            throw runtime_error("Truncated quad cache file: " + path);
+        }
+    }
+}
+
+size_t QuadCache::getNumLevels() const
+{
+    return _levels.size();
+}
+
+size_t QuadCache::getNumVertices(size_t level) const
+{
+    return _levels.at(level).numVertices;
+}
+
+size_t QuadCache::getNumFaces(size_t level) const
+{
+    return _levels.at(level).numFaces;
+}
+
+Quad QuadCache::getLevel(size_t level) const
+{
+    auto &entry = _levels.at(level);
+    ifstream input(_path, ios::binary);
+    if (!input || !input.seekg(entry.offset)) {
+        throw runtime_error("Could not read quad cache level " + to_string(level));
+    }
+
+    Quad quad;
+    Checksum sum;
+
+    // Positions are widened into Vertex structs a chunk at a time
+    quad._vertices.resize(entry.numVertices);
+    vector<char> buffer(12 * min<size_t>(entry.numVertices, vertexChunkSize));
+    for (size_t first = 0; first < entry.numVertices; first += vertexChunkSize) {
+        auto count = min<size_t>(entry.numVertices - first, vertexChunkSize);
+        input.read(buffer.data(), 12 * count);
+        sum.add(buffer.data(), 12 * count);
+        for (size_t i = 0; i < count; i++) {
+            auto p = &buffer[12 * i];
+            quad._vertices[first + i] = {{readFloat(p), readFloat(p + 4), readFloat(p + 8)},
+                                         {0.0, 0.0, 0.0}};
+        }
+    }
+
+    // Half-edges are read straight into mesh when layouts match
+    auto numEdges = 4 * size_t(entry.numFaces);
+    quad._edges.resize(numEdges);
+    if (isLittleEndian() && sizeof(Edge) == 8) {
+        auto edges = reinterpret_cast<char *>(quad._edges.data());
+        input.read(edges, numEdges * 8);
+        sum.add(edges, numEdges * 8);
+    }
+    else {
+        buffer.resize(numEdges * 8);
+        input.read(buffer.data(), buffer.size());
+        sum.add(buffer.data(), buffer.size());
+        for (size_t e = 0; e < numEdges; e++) {
+            quad._edges[e] = {readLittle<int32_t>(&buffer[8 * e]), readLittle<int32_t>(&buffer[8 * e + 4])};
+        }
+    }
+    if (!input) {
+        throw runtime_error("Truncated quad cache level " + to_string(level));
+    }
+    if (sum.finish() != entry.checksum) {
+        throw runtime_error("Checksum mismatch in quad cache level " + to_string(level));
+    }
+
+    for (size_t e = 0; e < numEdges; e++) {
+        auto &edge = quad._edges[e];
+        if (edge.vertex < 0 || uint32_t(edge.vertex) >= entry.numVertices ||
+            edge.opposite < -1 || edge.opposite >= EdgeID(numEdges)) {
+            throw runtime_error("Invalid half-edge in quad cache level " + to_string(level));
+        }
+        // Pairs must point at each other
+        if (edge.opposite != -1 &&
+            (edge.opposite == EdgeID(e) || quad._edges[edge.opposite].opposite != EdgeID(e))) {
+            throw runtime_error("Unpaired half-edge in quad cache level " + to_string(level));
+        }
+    }
+    quad._faces.resize(entry.numFaces);
+
+    // Half-edges are already paired; unpaired ones are found again by
+    // buildEdgeMap() if more faces are added
+    quad._edgeMapValid = false;
+    return quad;
+}
+
+void QuadCache::write(const string &path, const Quad &quad)
+{
+    write(path, vector<const Quad *>{&quad});
+}
+
+void QuadCache::write(const string &path, const vector<const Quad *> &levels)
+{
+    // Checked before file is replaced
+    for (auto quad: levels) {
+        if (quad->getNumAttributes() > 0) {
+            throw invalid_argument("Attribute channels can't be stored in quad cache");
+        }
+    }
+
+    ofstream output(path, ios::binary | ios::trunc);
+    if (!output) {
+        throw runtime_error("Could not open file for writing: " + path);
+    }
+
+    auto tableSize = headerSize + levels.size() * levelEntrySize;
+    vector<char> table(tableSize);
+    memcpy(table.data(), magic, sizeof(magic));
+    writeLittle<uint32_t>(&table[8], version);
+    writeLittle<uint32_t>(&table[12], levels.size());
+    output.write(table.data(), table.size());
+
+    // Write each level's data after table, then go back and fill in table
+    uint64_t offset = tableSize;
+    vector<char> buffer;
+    for (size_t i = 0; i < levels.size(); i++) {
+        auto &quad = *levels[i];
+        auto numVertices = quad._vertices.size();
+        auto numFaces = quad._faces.size();
+        if (quad._edges.size() > size_t(INT32_MAX)) {
+            throw runtime_error("Mesh too large for quad cache");
+        }
+
+        buffer.resize(levelDataSize(numVertices, numFaces));
+        for (size_t v = 0; v < numVertices; v++) {
+            auto &position = quad._vertices[v].position;
+            writeFloat(&buffer[12 * v], position.x);
+            writeFloat(&buffer[12 * v + 4], position.y);
+            writeFloat(&buffer[12 * v + 8], position.z);
+        }
+        auto edges = &buffer[12 * numVertices];
+        for (size_t e = 0; e < quad._edges.size(); e++) {
+            writeLittle<int32_t>(edges + 8 * e, quad._edges[e].vertex);
+            writeLittle<int32_t>(edges + 8 * e + 4, quad._edges[e].opposite);
+        }
+        output.write(buffer.data(), buffer.size());
+
+        auto entry = &table[headerSize + i * levelEntrySize];
+        writeLittle<uint64_t>(entry, offset);
+        writeLittle<uint32_t>(entry + 8, numVertices);
+        writeLittle<uint32_t>(entry + 12, numFaces);
+        Checksum sum;
+        sum.add(buffer.data(), buffer.size());
+        writeLittle<uint64_t>(entry + 16, sum.finish());
+        offset += buffer.size();
+    }
+
+    output.seekp(0);
+    output.write(table.data(), table.size());
+    if (!output) {
+        throw runtime_error("Could not write file: " + path);
+    }
+}
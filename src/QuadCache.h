@@ -0,0 +1,73 @@
+#ifndef OFXQUAD_QUADCACHE_H
+#define OFXQUAD_QUADCACHE_H
+
+#include "Quad.h"
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace ofx
+{
+
+// Binary file holding one or more Quads, typically a control mesh followed
+// by its subdivided levels, so that startup doesn't need OBJ parsing,
+// edge pairing or subdivision.
+//
+// All values are little-endian 32-bit words unless noted:
+//
+//     header:      magic "ofxQuad" + '\0' (8 bytes), version, numLevels
+//     level table: per level, uint64 offset of level data from start of
+//                  file, numVertices, numFaces, uint64 checksum
+//     level data:  numVertices * (x, y, z) float positions, then
+//                  4 * numFaces * (vertex, opposite) int32 half-edges
+//
+// Normals aren't stored; they're recalculated on draw. Checksum is 64-bit
+// FNV-1a over level data read as little-endian 64-bit words, with last
+// word zero padded.
+class QuadCache
+{
+public:
+    static const uint32_t version = 1;
+
+    // Read header and level table of cache file. Levels are read from
+    // file when requested. Throws std::runtime_error if file isn't a valid
+    // cache.
+    QuadCache(const std::string &path);
+
+    std::size_t getNumLevels() const;
+    std::size_t getNumVertices(std::size_t level) const;
+    std::size_t getNumFaces(std::size_t level) const;
+
+    // Read level with one pass over its arrays. Positions are widened into
+    // Vertex structs, which also hold normals, so they can't be used in
+    // place; half-edges are read straight into mesh. Checksum, vertex and
+    // edge IDs and pairing of opposite half-edges are checked; throws
+    // std::runtime_error on mismatch and std::out_of_range for missing
+    // level.
+    Quad getLevel(std::size_t level) const;
+
+    // Write levels to file, replacing it. Throws std::invalid_argument if
+    // a level has attribute channels, which format doesn't hold, and
+    // std::runtime_error if file can't be written.
+    static void write(const std::string &path, const std::vector<const Quad *> &levels);
+    static void write(const std::string &path, const Quad &quad);
+
+private:
+    std::string _path;
+
+    struct Level
+    {
+        uint64_t offset;
+        uint32_t numVertices;
+        uint32_t numFaces;
+        uint64_t checksum;
+    };
+    std::vector<Level> _levels;
+};
+
+};
+
+
+#endif
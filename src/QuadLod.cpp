@@ -0,0 +1,148 @@
+#include "QuadLod.h"
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+
+
+QuadLod::QuadLod(Quad base, int maxLevel, size_t memoryBudget, const SubdivideOptions &options)
+    : _memoryBudget(memoryBudget), _options(options), _clock(0)
+{
+    if (maxLevel < 0) {
+        throw invalid_argument("subdivision level must not be negative");
+    }
+    _levels.resize(maxLevel + 1);
+    _levels[0].quad.reset(new Quad(move(base)));
+    touch(0);
+}
+
+int QuadLod::getMaxLevel() const
+{
+    return _levels.size() - 1;
+}
+
+// Subdivide finest cached level below requested one a level at a time,
+// caching each intermediate level as well
+Quad &QuadLod::getLevel(int level)
+{
+    if (level < 0 || level >= int(_levels.size())) {
+        throw out_of_range("level of detail out of range");
+    }
+    if (!_levels[level].quad) {
+        if (_options.limitSurface) {
+            _levels[level].quad.reset(new Quad(_levels[0].quad->subdivide(level, _options)));
+            touch(level);
+        }
+        else {
+            int parent = level - 1;
+            while (!_levels[parent].quad) {
+                parent--;
+            }
+            for (int i = parent + 1; i <= level; i++) {
+                _levels[i].quad.reset(new Quad(_levels[i - 1].quad->subdivide(1, _options)));
+                touch(i);
+                evict(i);
+            }
+        }
+    }
+    touch(level);
+    evict(level);
+    return *_levels[level].quad;
+}
+
+bool QuadLod::isCached(int level) const
+{
+    return level >= 0 && level < int(_levels.size()) && _levels[level].quad;
+}
+
+size_t QuadLod::getMemoryUsage() const
+{
+    size_t bytes = 0;
+    for (auto &level: _levels) {
+        if (level.quad) {
+            bytes += level.quad->getMemoryUsage();
+        }
+    }
+    return bytes;
+}
+
+size_t QuadLod::getMemoryBudget() const
+{
+    return _memoryBudget;
+}
+
+void QuadLod::setMemoryBudget(size_t memoryBudget)
+{
+    _memoryBudget = memoryBudget;
+    evict(-1);
+}
+
+int ofx::getLevelForDistance(int maxLevel, float distance, float detailDistance)
+{
+    if (!(distance > detailDistance)) {
+        return maxLevel;
+    }
+    int coarser = int(floor(log2(distance / detailDistance)));
+    return max(maxLevel - coarser, 0);
+}
+
+int QuadLod::getLevelForDistance(float distance, float detailDistance) const
+{
+    return ofx::getLevelForDistance(getMaxLevel(), distance, detailDistance);
+}
+
+// Draw buffers are built on first draw of a level, so memory usage is
+// measured again afterwards
+void QuadLod::draw(int level, bool smoothShading)
+{
+    getLevel(level).draw(smoothShading);
+    touch(level);
+    evict(level);
+}
+
+void QuadLod::drawWireframe(int level)
+{
+    getLevel(level).drawWireframe();
+    touch(level);
+    evict(level);
+}
+
+// Mark level as most recently used and remeasure its memory, which
+// changes when draw buffers are built
+void QuadLod::touch(int level)
+{
+    auto &data = _levels[level];
+    data.lastUse = ++_clock;
+    data.memoryUsage = data.quad->getMemoryUsage();
+}
+
+// Drop least recently used levels until cache fits budget, keeping base
+// level and keepLevel
+void QuadLod::evict(int keepLevel)
+{
+    if (_memoryBudget == 0) {
+        return;
+    }
+
+    size_t total = 0;
+    for (auto &level: _levels) {
+        if (level.quad) {
+            total += level.memoryUsage;
+        }
+    }
+    while (total > _memoryBudget) {
+        int oldest = -1;
+        for (int i = 1; i < int(_levels.size()); i++) {
+            if (i != keepLevel && _levels[i].quad &&
+                (oldest == -1 || _levels[i].lastUse < _levels[oldest].lastUse)) {
+                oldest = i;
+            }
+        }
+        if (oldest == -1) {
+            break;
+        }
+        total -= _levels[oldest].memoryUsage;
+        _levels[oldest].quad.reset();
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef OFXQUAD_QUADLOD_H
+#define OFXQUAD_QUADLOD_H
+
+#include "Quad.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+namespace ofx
+{
+
+// Level between 0 and maxLevel to draw at given camera distance: maxLevel
+// at detailDistance or closer, one level coarser each time distance
+// doubles
+int getLevelForDistance(int maxLevel, float distance, float detailDistance);
+
+// Subdivided levels of a base mesh for switching level of detail at
+// runtime. Levels are built on first request, from finest cached level
+// below them, and stay cached together with their draw buffers, so
+// drawing a cached level again only binds its buffers. When cached levels
+// use more memory than budget, least recently used ones are dropped.
+class QuadLod
+{
+public:
+    // Levels 0 to maxLevel of base mesh, which can be moved in. Memory
+    // budget in bytes, as reported by Quad::getMemoryUsage(), with 0
+    // meaning no limit. Base level and most recently requested level are
+    // never dropped. With options.limitSurface, projected levels can't be
+    // subdivided further, so each level is built from base mesh.
+    QuadLod(Quad base, int maxLevel, std::size_t memoryBudget=0,
+            const SubdivideOptions &options=SubdivideOptions());
+
+    int getMaxLevel() const;
+
+    // Mesh at given level, building it if needed. Reference stays valid
+    // until next call that may build a level. Throws std::out_of_range for
+    // levels outside 0 to maxLevel.
+    Quad &getLevel(int level);
+
+    bool isCached(int level) const;
+
+    // Memory used by cached levels
+    std::size_t getMemoryUsage() const;
+
+    std::size_t getMemoryBudget() const;
+    void setMemoryBudget(std::size_t memoryBudget);
+
+    // Finest level at detailDistance or closer, one level coarser each time
+    // distance doubles
+    int getLevelForDistance(float distance, float detailDistance) const;
+
+    void draw(int level, bool smoothShading=true);
+    void drawWireframe(int level);
+
+private:
+    struct Level
+    {
+        std::unique_ptr<Quad> quad;
+        // Memory usage when last measured; draw buffers grow on first draw
+        std::size_t memoryUsage;
+        uint64_t lastUse;
+    };
+
+    std::vector<Level> _levels;
+    std::size_t _memoryBudget;
+    SubdivideOptions _options;
+    uint64_t _clock;
+
+    void touch(int level);
+    void evict(int keepLevel);
+};
+
+};
+
+
+#endif
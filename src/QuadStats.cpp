@@ -0,0 +1,34 @@
+#include "QuadStats.h"
+
+using namespace std;
+using namespace ofx;
+
+
+string ofx::getPhaseName(QuadPhase phase)
+{
+    switch (phase) {
+    case QuadPhase::FacePoints:
+        return "face points";
+    case QuadPhase::EdgePoints:
+        return "edge points";
+    case QuadPhase::VertexPoints:
+        return "vertex points";
+    case QuadPhase::ChildTopology:
+        return "child topology";
+    case QuadPhase::Normals:
+        return "normals";
+    default:
+        return "mesh rebuild";
+    }
+}
+
+QuadStats &QuadStats::operator+=(const QuadStats &other)
+{
+    for (size_t i = 0; i < numQuadPhases; i++) {
+        phases[i].ms += other.phases[i].ms;
+        phases[i].calls += other.phases[i].calls;
+    }
+    edgeMapLookups += other.edgeMapLookups;
+    allocations += other.allocations;
+    return *this;
+}
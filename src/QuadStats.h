@@ -0,0 +1,119 @@
+#ifndef OFXQUAD_QUADSTATS_H
+#define OFXQUAD_QUADSTATS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Build with OFXQUAD_STATS defined as 1 to collect phase times and
+// counters. When it is 0, instrumentation macros expand to nothing and
+// only memory figures of Quad::getStats() are filled in.
+#ifndef OFXQUAD_STATS
+#define OFXQUAD_STATS 0
+#endif
+
+
+namespace ofx
+{
+
+// Instrumented phases of subdivision and drawing
+enum class QuadPhase
+{
+    FacePoints,
+    EdgePoints,
+    VertexPoints,
+    ChildTopology,
+    Normals,
+    MeshRebuild
+};
+
+const std::size_t numQuadPhases = 6;
+
+std::string getPhaseName(QuadPhase phase);
+
+struct PhaseStats
+{
+    // Total time spent in phase
+    double ms = 0.0;
+    // Timed sections; edge points are timed twice per subdivided level,
+    // for numbering and for positions
+    uint64_t calls = 0;
+};
+
+// Counters returned by Quad::getStats(). Times and counts add up from
+// construction or last Quad::resetStats(); byte counts are measured when
+// stats are requested.
+struct QuadStats
+{
+    std::array<PhaseStats, numQuadPhases> phases;
+
+    // Finds, inserts and erases on edge map
+    uint64_t edgeMapLookups = 0;
+
+    // Heap allocations of mesh arrays, draw buffers and edge map entries,
+    // including scratch arrays of subdivideInPlace()
+    uint64_t allocations = 0;
+
+    // Bytes held by each part of mesh, as summed by Quad::getMemoryUsage()
+    std::size_t vertexBytes = 0;
+    std::size_t edgeBytes = 0;
+    std::size_t faceBytes = 0;
+    std::size_t edgeMapBytes = 0;
+    std::size_t attributeBytes = 0;
+    // CPU side of draw buffers of mesh and wireframe
+    std::size_t meshBytes = 0;
+
+    PhaseStats &operator[](QuadPhase phase) { return phases[std::size_t(phase)]; }
+    const PhaseStats &operator[](QuadPhase phase) const { return phases[std::size_t(phase)]; }
+
+    // Add times and counters of other stats; byte counts are left alone
+    QuadStats &operator+=(const QuadStats &other);
+};
+
+
+#if OFXQUAD_STATS
+
+// Adds time from construction to destruction to a phase
+class ScopedPhaseTimer
+{
+public:
+    ScopedPhaseTimer(QuadStats &stats, QuadPhase phase)
+        : _stats(stats[phase]), _start(std::chrono::steady_clock::now())
+    {
+
+    }
+
+    ~ScopedPhaseTimer()
+    {
+        auto end = std::chrono::steady_clock::now();
+        _stats.ms += std::chrono::duration<double, std::milli>(end - _start).count();
+        _stats.calls++;
+    }
+
+    ScopedPhaseTimer(const ScopedPhaseTimer &) = delete;
+    ScopedPhaseTimer &operator=(const ScopedPhaseTimer &) = delete;
+
+private:
+    PhaseStats &_stats;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Time rest of enclosing scope; one timer per scope
+#define OFXQUAD_TIME_PHASE(stats, phase) ofx::ScopedPhaseTimer ofxQuadPhaseTimer((stats), (phase))
+// Add count to a counter of QuadStats. Only used on calling thread of
+// parallel loops, so counters need no synchronization.
+#define OFXQUAD_COUNT(counter, count) ((counter) += (count))
+
+#else
+
+#define OFXQUAD_TIME_PHASE(stats, phase) ((void)0)
+#define OFXQUAD_COUNT(counter, count) ((void)0)
+
+#endif
+
+};
+
+
+#endif
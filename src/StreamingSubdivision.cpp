@@ -0,0 +1,408 @@
+#include "StreamingSubdivision.h"
+#include "Executor.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+
+
+namespace
+{
+
+// Output faces per tile aimed for by default tile size
+const size_t defaultTileFaces = size_t(1) << 18;
+
+// Tiles refined at once when running with an executor
+const size_t tilesPerBatch = 8;
+
+};
+
+
+StreamingSubdivision::StreamingSubdivision(const Quad &control, int level)
+    : _control(control), _level(level)
+{
+    if (level < 0) {
+        throw invalid_argument("subdivision level must not be negative");
+    }
+
+    auto &edges = control._edges;
+    _edgeIndices.assign(edges.size(), -1);
+    for (size_t edge = 0; edge < edges.size(); edge++) {
+        auto opposite = edges[edge].opposite;
+        if (opposite == -1) {
+            throw invalid_argument("streaming subdivision requires a closed mesh");
+        }
+        if (EdgeID(edge) < opposite) {
+            _edgeIndices[edge] = _edgeIndices[opposite] = _edgeFaces.size();
+            _edgeFaces.push_back(Quad::edgeFace(edge));
+        }
+    }
+
+    // Lowest face around each vertex
+    _vertexFaces.assign(control._vertices.size(), -1);
+    for (size_t edge = 0; edge < edges.size(); edge++) {
+        auto &face = _vertexFaces[edges[edge].vertex];
+        if (face == -1) {
+            face = Quad::edgeFace(edge);
+        }
+    }
+
+    if (getNumVertices() > size_t(numeric_limits<VertexID>::max())) {
+        throw overflow_error("too many output vertices for VertexID");
+    }
+
+    setTileSize(max<size_t>(defaultTileFaces >> min(2 * level, 18), 1));
+}
+
+size_t StreamingSubdivision::getNumVertices() const
+{
+    size_t inner = (size_t(1) << _level) - 1;
+    return _control._vertices.size() + _edgeFaces.size() * inner +
+           _control._faces.size() * inner * inner;
+}
+
+size_t StreamingSubdivision::getNumFaces() const
+{
+    return _control._faces.size() << (2 * _level);
+}
+
+size_t StreamingSubdivision::getTileSize() const
+{
+    return _tileSize;
+}
+
+void StreamingSubdivision::setTileSize(size_t numFaces)
+{
+    _tileSize = max<size_t>(numFaces, 1);
+}
+
+// Output ID of point on grid of control face, following layout in header
+VertexID StreamingSubdivision::pointId(FaceID face, GridPoint point) const
+{
+    int n = 1 << _level;
+    VertexID inner = n - 1;
+    auto x = point.x;
+    auto y = point.y;
+
+    int side;
+    int t;
+    if (y == 0) {
+        side = 0;
+        t = x;
+    }
+    else if (x == n) {
+        side = 1;
+        t = y;
+    }
+    else if (y == n) {
+        side = 2;
+        t = n - x;
+    }
+    else if (x == 0) {
+        side = 3;
+        t = n - y;
+    }
+    else {
+        return _control._vertices.size() + _edgeFaces.size() * inner +
+               (size_t(face) * inner + (y - 1)) * inner + (x - 1);
+    }
+
+    auto edge = Quad::faceEdge(face, side);
+    if (t == 0) {
+        return _control._edges[edge].vertex;
+    }
+    if (t == n) {
+        return _control._edges[Quad::nextEdge(edge)].vertex;
+    }
+    if (_control._edges[edge].opposite < edge) {
+        t = n - t;
+    }
+    return _control._vertices.size() + size_t(_edgeIndices[edge]) * inner + (t - 1);
+}
+
+FaceID StreamingSubdivision::ownerFace(VertexID id) const
+{
+    size_t inner = (size_t(1) << _level) - 1;
+    size_t index = id;
+    if (index < _vertexFaces.size()) {
+        return _vertexFaces[index];
+    }
+    index -= _vertexFaces.size();
+    if (index < _edgeFaces.size() * inner) {
+        return _edgeFaces[index / inner];
+    }
+    index -= _edgeFaces.size() * inner;
+    return index / (inner * inner);
+}
+
+// Build mesh of tile faces and faces sharing a vertex with them, and
+// subdivide it a level at a time. Points of children of tile faces, and of
+// children sharing a vertex with them, only depend on faces of this mesh;
+// after each level only those children are kept, so mesh stays a tile
+// with one ring of faces around it. Vertices and edges on outer border
+// have no full ring; their points are dropped by that step, and are
+// filled in with plain positions and midpoints meanwhile.
+void StreamingSubdivision::refineTile(size_t tile, Tile &output) const
+{
+    auto &edges = _control._edges;
+    FaceID firstFace = tile * _tileSize;
+    FaceID endFace = min((tile + 1) * _tileSize, _control._faces.size());
+
+    vector<FaceID> faces;
+    for (auto face = firstFace; face < endFace; face++) {
+        faces.push_back(face);
+    }
+    vector<FaceID> ring;
+    for (auto face = firstFace; face < endFace; face++) {
+        for (int corner = 0; corner < 4; corner++) {
+            auto edge = Quad::faceEdge(face, corner);
+            auto e = edge;
+            do {
+                auto other = Quad::edgeFace(e);
+                if (other < firstFace || other >= endFace) {
+                    ring.push_back(other);
+                }
+                e = Quad::nextEdge(edges[e].opposite);
+            } while (e != edge);
+        }
+    }
+    sort(ring.begin(), ring.end());
+    ring.erase(unique(ring.begin(), ring.end()), ring.end());
+    faces.insert(faces.end(), ring.begin(), ring.end());
+
+    vector<VertexID> ids;
+    for (auto face: faces) {
+        for (int corner = 0; corner < 4; corner++) {
+            ids.push_back(edges[Quad::faceEdge(face, corner)].vertex);
+        }
+    }
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    Quad mesh;
+    mesh._vertices.resize(ids.size());
+    for (size_t v = 0; v < ids.size(); v++) {
+        mesh._vertices[v].position = _control._vertices[ids[v]].position;
+    }
+    vector<array<VertexID, 4>> meshFaces(faces.size());
+    vector<FaceID> baseFaces = faces;
+    int n = 1 << _level;
+    vector<array<GridPoint, 4>> grid(faces.size(), {{{0, 0}, {n, 0}, {n, n}, {0, n}}});
+    for (size_t f = 0; f < faces.size(); f++) {
+        for (int corner = 0; corner < 4; corner++) {
+            auto v = edges[Quad::faceEdge(faces[f], corner)].vertex;
+            meshFaces[f][corner] = lower_bound(ids.begin(), ids.end(), v) - ids.begin();
+        }
+    }
+    mesh.addFaces(meshFaces);
+
+    for (int level = 0; level < _level; level++) {
+        auto numFaces = mesh._faces.size();
+        vector<Vertex> facePoints(numFaces);
+        for (size_t face = 0; face < numFaces; face++) {
+            facePoints[face].position = mesh.facePoint(face);
+        }
+
+        Quad child;
+        vector<VertexID> childIds;
+        child._vertices.reserve(mesh._vertices.size() + mesh._edges.size() / 2 + numFaces + numFaces / 2);
+
+        // Vertices on outer border keep their position
+        vector<char> border(mesh._vertices.size(), 0);
+        for (size_t edge = 0; edge < mesh._edges.size(); edge++) {
+            if (mesh._edges[edge].opposite == -1) {
+                border[mesh._edges[edge].vertex] = 1;
+                border[mesh._edges[Quad::nextEdge(edge)].vertex] = 1;
+            }
+        }
+
+        vector<VertexID> vertexPoints(mesh._vertices.size(), -1);
+        vector<VertexID> edgePoints(mesh._edges.size(), -1);
+        vector<array<VertexID, 4>> childFaces(4 * numFaces);
+        vector<FaceID> childBaseFaces(4 * numFaces);
+        vector<array<GridPoint, 4>> childGrid(4 * numFaces);
+
+        auto midpoint = [](GridPoint a, GridPoint b) {
+            return GridPoint{(a.x + b.x) / 2, (a.y + b.y) / 2};
+        };
+        for (size_t face = 0; face < numFaces; face++) {
+            auto &corners = grid[face];
+            for (int corner = 0; corner < 4; corner++) {
+                auto edge = Quad::faceEdge(face, corner);
+                auto v = mesh._edges[edge].vertex;
+                if (vertexPoints[v] == -1) {
+                    vertexPoints[v] = child._vertices.size();
+                    child._vertices.push_back({border[v] ? mesh._vertices[v].position :
+                                               mesh.vertexPoint(edge, facePoints.data()), {}});
+                    childIds.push_back(ids[v]);
+                }
+                if (edgePoints[edge] == -1) {
+                    auto opposite = mesh._edges[edge].opposite;
+                    ofVec3f position;
+                    if (opposite == -1) {
+                        position = (mesh._vertices[v].position +
+                                    mesh._vertices[mesh._edges[Quad::nextEdge(edge)].vertex].position) / 2.0f;
+                    }
+                    else {
+                        position = mesh.edgePoint(edge, facePoints.data());
+                        edgePoints[opposite] = child._vertices.size();
+                    }
+                    edgePoints[edge] = child._vertices.size();
+                    child._vertices.push_back({position, {}});
+                    childIds.push_back(pointId(baseFaces[face], midpoint(corners[corner], corners[(corner + 1) & 3])));
+                }
+            }
+
+            VertexID center = child._vertices.size();
+            child._vertices.push_back(facePoints[face]);
+            childIds.push_back(pointId(baseFaces[face], midpoint(corners[0], corners[2])));
+
+            for (int corner = 0; corner < 4; corner++) {
+                auto edge = Quad::faceEdge(face, corner);
+                auto prev = Quad::prevEdge(edge);
+                auto childFace = Quad::faceEdge(face, corner);
+                childFaces[childFace] = {vertexPoints[mesh._edges[edge].vertex], edgePoints[edge], center,
+                                         edgePoints[prev]};
+                childBaseFaces[childFace] = baseFaces[face];
+                childGrid[childFace] = {{corners[corner], midpoint(corners[corner], corners[(corner + 1) & 3]),
+                                         midpoint(corners[0], corners[2]),
+                                         midpoint(corners[(corner + 3) & 3], corners[corner])}};
+            }
+        }
+
+        // Keep tile faces and faces sharing a vertex with them, compacting
+        // vertices in order of first use
+        vector<char> nearTile(child._vertices.size(), 0);
+        for (size_t face = 0; face < childFaces.size(); face++) {
+            if (childBaseFaces[face] >= firstFace && childBaseFaces[face] < endFace) {
+                for (auto v: childFaces[face]) {
+                    nearTile[v] = 1;
+                }
+            }
+        }
+        vector<FaceID> faceRemap(childFaces.size(), -1);
+        size_t numKept = 0;
+        for (size_t face = 0; face < childFaces.size(); face++) {
+            for (auto v: childFaces[face]) {
+                if (nearTile[v]) {
+                    faceRemap[face] = numKept++;
+                    break;
+                }
+            }
+        }
+        auto keptEdge = [&](EdgeID edge) {
+            if (edge == -1 || faceRemap[Quad::edgeFace(edge)] == -1) {
+                return EdgeID(-1);
+            }
+            return Quad::faceEdge(faceRemap[Quad::edgeFace(edge)], edge & 3);
+        };
+
+        // Child face 4f + i is made from parent half-edge 4f + i; its
+        // half-edges pair up as in Quad::buildChildTopology(), except where
+        // parent edge or other child face is missing
+        Quad next;
+        next._faces.resize(numKept);
+        next._edges.resize(4 * numKept);
+        next._edgeMapValid = false;
+        vector<VertexID> remap(child._vertices.size(), -1);
+        ids.clear();
+        for (size_t face = 0; face < childFaces.size(); face++) {
+            auto kept = faceRemap[face];
+            if (kept == -1) {
+                continue;
+            }
+            EdgeID edge = face;
+            auto prev = Quad::prevEdge(edge);
+            auto opposite = mesh._edges[edge].opposite;
+            auto prevOpposite = mesh._edges[prev].opposite;
+            EdgeID opposites[4] = {opposite == -1 ? -1 : 4 * Quad::nextEdge(opposite) + 3,
+                                   4 * Quad::nextEdge(edge) + 2, 4 * prev + 1,
+                                   prevOpposite == -1 ? -1 : 4 * prevOpposite};
+            for (int corner = 0; corner < 4; corner++) {
+                auto v = childFaces[face][corner];
+                if (remap[v] == -1) {
+                    remap[v] = next._vertices.size();
+                    next._vertices.push_back(child._vertices[v]);
+                    ids.push_back(childIds[v]);
+                }
+                next._edges[Quad::faceEdge(kept, corner)] = {remap[v], keptEdge(opposites[corner])};
+            }
+            childBaseFaces[kept] = childBaseFaces[face];
+            childGrid[kept] = childGrid[face];
+        }
+        childBaseFaces.resize(numKept);
+        childGrid.resize(numKept);
+        mesh = move(next);
+
+        baseFaces = move(childBaseFaces);
+        grid = move(childGrid);
+    }
+
+    for (size_t face = 0; face < mesh._faces.size(); face++) {
+        mesh._faces[face].normal = mesh.faceNormal(face);
+    }
+
+    output.faces.clear();
+    for (size_t face = 0; face < mesh._faces.size(); face++) {
+        if (baseFaces[face] >= firstFace && baseFaces[face] < endFace) {
+            array<VertexID, 4> corners;
+            for (int corner = 0; corner < 4; corner++) {
+                corners[corner] = ids[mesh._edges[Quad::faceEdge(face, corner)].vertex];
+            }
+            output.faces.push_back(corners);
+        }
+    }
+
+    // Rings of owned vertices are closed and exact, so normals match
+    // Quad::calculateNormals() up to rounding
+    output.vertexIds.clear();
+    output.vertices.clear();
+    vector<char> done(mesh._vertices.size(), 0);
+    for (size_t edge = 0; edge < mesh._edges.size(); edge++) {
+        auto v = mesh._edges[edge].vertex;
+        if (done[v]) {
+            continue;
+        }
+        done[v] = 1;
+        auto owner = ownerFace(ids[v]);
+        if (owner >= firstFace && owner < endFace) {
+            output.vertexIds.push_back(ids[v]);
+            output.vertices.push_back({mesh._vertices[v].position, mesh.vertexNormal(edge)});
+        }
+    }
+}
+
+void StreamingSubdivision::run(SubdivisionSink &sink, Executor *executor) const
+{
+    sink.begin(getNumVertices(), getNumFaces());
+
+    Tile isolated;
+    for (size_t v = 0; v < _vertexFaces.size(); v++) {
+        if (_vertexFaces[v] == -1) {
+            isolated.vertexIds.push_back(v);
+            isolated.vertices.push_back({_control._vertices[v].position, {0.0, 0.0, 0.0}});
+        }
+    }
+    if (!isolated.vertexIds.empty()) {
+        sink.addVertices(isolated.vertexIds.data(), isolated.vertices.data(), isolated.vertexIds.size());
+    }
+
+    auto numTiles = (_control._faces.size() + _tileSize - 1) / _tileSize;
+    vector<Tile> tiles(executor ? tilesPerBatch : 1);
+    for (size_t first = 0; first < numTiles; first += tiles.size()) {
+        auto count = min(tiles.size(), numTiles - first);
+        parallelForBlocks(executor, count, 1, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i++) {
+                refineTile(first + i, tiles[i]);
+            }
+        });
+        for (size_t i = 0; i < count; i++) {
+            auto &tile = tiles[i];
+            sink.addVertices(tile.vertexIds.data(), tile.vertices.data(), tile.vertexIds.size());
+            sink.addFaces(tile.faces.data(), tile.faces.size());
+        }
+    }
+    sink.end();
+}
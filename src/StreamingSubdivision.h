@@ -0,0 +1,90 @@
+#ifndef OFXQUAD_STREAMINGSUBDIVISION_H
+#define OFXQUAD_STREAMINGSUBDIVISION_H
+
+#include "Quad.h"
+#include "SubdivisionSink.h"
+#include <vector>
+#include <array>
+#include <cstddef>
+
+
+namespace ofx
+{
+
+class Executor;
+
+// Catmull-Clark subdivision that never holds whole output mesh. Control
+// faces are refined in tiles of consecutive face IDs; each tile is
+// subdivided together with the ring of faces around it, which is all that
+// points of tile depend on, and its faces and vertices are passed to a
+// sink. Peak memory depends on tile size rather than output size.
+//
+// Output vertex IDs depend only on control mesh and level, not on tiles:
+// with n = 2^level, IDs are laid out as
+//
+//     control vertices, E * (n - 1) points inside control edges,
+//     F * (n - 1)^2 points inside control faces
+//
+// Points inside an edge are ordered from start vertex of its lower
+// half-edge; points inside face f are ordered by row, from corner 0 along
+// first edge. Each vertex is passed once, by tile owning the face it lies
+// in (for edge points, face of lower half-edge; for control vertices, lowest
+// face around them). Positions match Quad::subdivide() up to rounding.
+class StreamingSubdivision
+{
+public:
+    // Throws std::invalid_argument if level is negative or control mesh
+    // isn't closed, and std::overflow_error if output vertex IDs don't fit
+    // VertexID. Control mesh must outlive StreamingSubdivision.
+    StreamingSubdivision(const Quad &control, int level);
+
+    std::size_t getNumVertices() const;
+    std::size_t getNumFaces() const;
+
+    // Control faces per tile. Default keeps about 2^18 output faces per
+    // tile.
+    std::size_t getTileSize() const;
+    void setTileSize(std::size_t numFaces);
+
+    // Subdivide and pass output to sink. Executor refines several tiles at
+    // once; sink is only called from calling thread, in tile order.
+    void run(SubdivisionSink &sink, Executor *executor=nullptr) const;
+
+private:
+    // Output of one tile
+    struct Tile
+    {
+        std::vector<VertexID> vertexIds;
+        std::vector<Vertex> vertices;
+        std::vector<std::array<VertexID, 4>> faces;
+    };
+
+    // Position within control face on grid of n + 1 by n + 1 points, with
+    // corner 0 at (0, 0), corner 1 at (n, 0) and corner 3 at (0, n)
+    struct GridPoint
+    {
+        int x;
+        int y;
+    };
+
+    const Quad &_control;
+    int _level;
+    std::size_t _tileSize;
+
+    // Index of each half-edge's edge, counting lower half-edges in order
+    std::vector<VertexID> _edgeIndices;
+    // Face of lower half-edge of each edge
+    std::vector<FaceID> _edgeFaces;
+    // Face whose tile passes each control vertex; -1 for vertices without
+    // faces, which are passed before first tile
+    std::vector<FaceID> _vertexFaces;
+
+    VertexID pointId(FaceID face, GridPoint point) const;
+    FaceID ownerFace(VertexID id) const;
+    void refineTile(std::size_t tile, Tile &output) const;
+};
+
+};
+
+
+#endif
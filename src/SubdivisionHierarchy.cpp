@@ -0,0 +1,175 @@
+#include "SubdivisionHierarchy.h"
+#include "Executor.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+
+
+SubdivisionHierarchy::SubdivisionHierarchy(const Quad &control, int level, Executor *executor)
+    : _executor(executor), _mark(0)
+{
+    if (level < 0) {
+        throw invalid_argument("subdivision level must not be negative");
+    }
+
+    SubdivideOptions options;
+    options.executor = executor;
+
+    _quads.reserve(level + 1);
+    _quads.push_back(control);
+    _levels.resize(level);
+    for (int i = 0; i < level; i++) {
+        auto &parent = _quads[i];
+        auto &data = _levels[i];
+
+        size_t numEdgePoints;
+        data.midpoints = parent.edgePoints(executor, numEdgePoints);
+        data.vertexEdges.assign(parent._vertices.size(), -1);
+        for (size_t edge = 0; edge < parent._edges.size(); edge++) {
+            if (parent.ownsVertex(edge)) {
+                data.vertexEdges[parent._edges[edge].vertex] = edge;
+            }
+        }
+
+        _quads.push_back(parent.subdivide(1, options));
+        data.marks.assign(_quads.back()._vertices.size(), 0);
+    }
+    _normals.reset(new NormalEngine(_quads.back()));
+}
+
+int SubdivisionHierarchy::getLevel() const
+{
+    return _levels.size();
+}
+
+const Quad &SubdivisionHierarchy::getQuad(int level) const
+{
+    return _quads.at(level);
+}
+
+Quad &SubdivisionHierarchy::getSubdivided()
+{
+    return _quads.back();
+}
+
+void SubdivisionHierarchy::update(const Quad &control, const vector<VertexID> &modifiedVertices)
+{
+    const size_t blockSize = 1024;
+
+    auto &base = _quads[0];
+    if (control._vertices.size() != base._vertices.size() ||
+        control._faces.size() != base._faces.size()) {
+        throw invalid_argument("mesh does not match subdivision hierarchy");
+    }
+    for (auto v: modifiedVertices) {
+        if (v < 0 || size_t(v) >= base._vertices.size()) {
+            throw invalid_argument("modified vertex does not exist");
+        }
+        base._vertices[v].position = control._vertices[v].position;
+    }
+
+    if (++_mark == 0) {
+        for (auto &data: _levels) {
+            fill(data.marks.begin(), data.marks.end(), 0);
+        }
+        _mark = 1;
+    }
+
+    // Vertices moved in current level, and points of next level that
+    // depend on them: faces around moved vertices, edges of those faces
+    // (by owning half-edge) and corners of those faces
+    vector<VertexID> moved = modifiedVertices;
+    vector<FaceID> faces;
+    vector<EdgeID> edges;
+    vector<VertexID> vertices;
+
+    for (size_t i = 0; i < _levels.size(); i++) {
+        auto &parent = _quads[i];
+        auto &child = _quads[i + 1];
+        auto &data = _levels[i];
+        VertexID firstVertexPoint = child._vertices.size() - parent._vertices.size();
+
+        faces.clear();
+        edges.clear();
+        vertices.clear();
+        auto mark = [&](VertexID childVertex) {
+            if (data.marks[childVertex] == _mark) {
+                return false;
+            }
+            data.marks[childVertex] = _mark;
+            return true;
+        };
+
+        for (auto v: moved) {
+            auto edge = data.vertexEdges[v];
+            if (edge == -1) {
+                if (mark(firstVertexPoint + v)) {
+                    vertices.push_back(v);
+                }
+                continue;
+            }
+            auto e = edge;
+            do {
+                if (mark(Quad::edgeFace(e))) {
+                    faces.push_back(Quad::edgeFace(e));
+                }
+                e = Quad::nextEdge(parent._edges[e].opposite);
+            } while (e != edge);
+        }
+        for (auto face: faces) {
+            for (int corner = 0; corner < 4; corner++) {
+                auto e = Quad::faceEdge(face, corner);
+                if (mark(data.midpoints[e])) {
+                    edges.push_back(min(e, parent._edges[e].opposite));
+                }
+                auto v = parent._edges[e].vertex;
+                if (mark(firstVertexPoint + v)) {
+                    vertices.push_back(v);
+                }
+            }
+        }
+
+        parallelForBlocks(_executor, faces.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto k = begin; k < end; k++) {
+                child._vertices[faces[k]].position = parent.facePoint(faces[k]);
+            }
+        });
+        parallelForBlocks(_executor, edges.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto k = begin; k < end; k++) {
+                child._vertices[data.midpoints[edges[k]]].position = parent.edgePoint(edges[k], child._vertices.data());
+            }
+        });
+        parallelForBlocks(_executor, vertices.size(), blockSize, [&](size_t begin, size_t end) {
+            for (auto k = begin; k < end; k++) {
+                auto v = vertices[k];
+                auto edge = data.vertexEdges[v];
+                child._vertices[firstVertexPoint + v].position =
+                    edge == -1 ? parent._vertices[v].position : parent.vertexPoint(edge, child._vertices.data());
+            }
+        });
+
+        // Only finest level is patched in place
+        parent.meshChanged();
+
+        moved.clear();
+        moved.insert(moved.end(), faces.begin(), faces.end());
+        for (auto e: edges) {
+            moved.push_back(data.midpoints[e]);
+        }
+        for (auto v: vertices) {
+            moved.push_back(firstVertexPoint + v);
+        }
+    }
+
+    auto &finest = _quads.back();
+    if (finest._normalsValid) {
+        _normals->update(finest, moved, _executor);
+        finest.patchDrawing(_normals->getUpdatedVertices(), _normals->getUpdatedFaces());
+    }
+    else {
+        finest.meshChanged();
+        finest.calculateNormals(_executor);
+    }
+}
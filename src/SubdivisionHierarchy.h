@@ -0,0 +1,67 @@
+#ifndef OFXQUAD_SUBDIVISIONHIERARCHY_H
+#define OFXQUAD_SUBDIVISIONHIERARCHY_H
+
+#include "Quad.h"
+#include "NormalEngine.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+namespace ofx
+{
+
+class Executor;
+
+// Control mesh together with all of its subdivided levels, kept so that
+// moving a few control vertices only updates the vertices they influence.
+// Catmull-Clark points only depend on the faces around a vertex, so each
+// level only recalculates points of faces around the vertices that moved
+// in the level above. Normals and draw buffers of finest level are
+// patched in place, so cost of update scales with size of edit rather
+// than size of mesh.
+class SubdivisionHierarchy
+{
+public:
+    SubdivisionHierarchy(const Quad &control, int level=1, Executor *executor=nullptr);
+
+    int getLevel() const;
+
+    // Mesh at given level, 0 being copy of control mesh
+    const Quad &getQuad(int level) const;
+
+    // Finest level, for drawing
+    Quad &getSubdivided();
+
+    // Copy positions of modified vertices from control mesh and update
+    // every level. Results are identical to subdividing control mesh
+    // again. Throws std::invalid_argument if control mesh doesn't match
+    // mesh hierarchy was built from.
+    void update(const Quad &control, const std::vector<VertexID> &modifiedVertices);
+
+private:
+    // Data linking a level to the next finer one
+    struct Level
+    {
+        // Edge point in next level for each half-edge
+        std::vector<VertexID> midpoints;
+
+        // Half-edge owning each vertex, or -1 for vertices without faces
+        std::vector<EdgeID> vertexEdges;
+
+        // Marks on vertices of next level, for collecting each point once
+        // per update
+        std::vector<uint32_t> marks;
+    };
+
+    std::vector<Quad> _quads;
+    std::vector<Level> _levels;
+    std::unique_ptr<NormalEngine> _normals;
+    Executor *_executor;
+    uint32_t _mark;
+};
+
+};
+
+
+#endif
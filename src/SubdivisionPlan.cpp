@@ -0,0 +1,197 @@
+#include "SubdivisionPlan.h"
+#include <stdexcept>
+
+using namespace std;
+using namespace ofx;
+
+namespace
+{
+
+// Sparse row of weights, indexed by vertex ID of previous level
+typedef vector<pair<VertexID, float>> Stencil;
+
+}
+
+// Build plan by subdividing control mesh one level at a time. Subdivided
+// vertex IDs follow a fixed layout (face points, edge points, vertex
+// points), which gives the local stencil of each new vertex in terms of
+// parent vertices. Local stencils are then multiplied with the composed
+// stencils of the parent level.
+SubdivisionPlan::SubdivisionPlan(const Quad &control, int level)
+    : _level(level), _numControlVertices(control._vertices.size())
+{
+    if (level < 0) {
+        throw invalid_argument("subdivision level must not be negative");
+    }
+
+    // Composed rows for current level; level 0 is identity
+    vector<Stencil> rows(_numControlVertices);
+    for (size_t i = 0; i < rows.size(); i++) {
+        rows[i].push_back({VertexID(i), 1.0f});
+    }
+
+    // Dense accumulator for composing rows, plus list of touched entries
+    vector<float> accumulator(_numControlVertices, 0.0f);
+    vector<VertexID> touched;
+
+    auto compose = [&](const Stencil &local) {
+        touched.clear();
+        for (auto &term: local) {
+            for (auto &parentTerm: rows[term.first]) {
+                if (accumulator[parentTerm.first] == 0.0f) {
+                    touched.push_back(parentTerm.first);
+                }
+                accumulator[parentTerm.first] += term.second * parentTerm.second;
+            }
+        }
+        Stencil row;
+        row.reserve(touched.size());
+        for (auto id: touched) {
+            if (accumulator[id] != 0.0f) {
+                row.push_back({id, accumulator[id]});
+            }
+            accumulator[id] = 0.0f;
+        }
+        return row;
+    };
+
+    Quad current = control;
+    for (int l = 0; l < level; l++) {
+        Quad next = current.subdivide(1);
+        vector<Stencil> localRows(next._vertices.size());
+
+        auto &edges = current._edges;
+        size_t numEdgePoints;
+        auto midpoints = current.edgePoints(nullptr, numEdgePoints);
+        VertexID firstVertexPoint = current._faces.size() + numEdgePoints;
+
+        auto addFaceCorners = [&](Stencil &stencil, FaceID face, float weight) {
+            for (int i = 0; i < 4; i++) {
+                stencil.push_back({edges[Quad::faceEdge(face, i)].vertex, weight});
+            }
+        };
+
+        // Vertices that aren't part of any face keep their position
+        for (size_t v = 0; v < current._vertices.size(); v++) {
+            localRows[firstVertexPoint + v].push_back({VertexID(v), 1.0f});
+        }
+
+        // Face points: average of four corners
+        for (size_t f = 0; f < current._faces.size(); f++) {
+            addFaceCorners(localRows[f], f, 0.25f);
+        }
+
+        // Edge points: average of endpoints and both adjacent face points
+        for (size_t e = 0; e < edges.size(); e++) {
+            auto &edge = edges[e];
+            if (EdgeID(e) > edge.opposite) {
+                continue;
+            }
+            auto &stencil = localRows[midpoints[e]];
+            stencil.push_back({edge.vertex, 0.25f});
+            stencil.push_back({edges[edge.opposite].vertex, 0.25f});
+            addFaceCorners(stencil, Quad::edgeFace(e), 0.0625f);
+            addFaceCorners(stencil, Quad::edgeFace(edge.opposite), 0.0625f);
+        }
+
+        // Vertex points: (Q/n + 2R/n + (n - 3)P) / n, where Q is average of
+        // adjacent face points and R is average of adjacent edge midpoints.
+        vector<bool> done(current._vertices.size(), false);
+        for (size_t edge = 0; edge < edges.size(); edge++) {
+            auto vertex = edges[edge].vertex;
+            if (done[vertex]) {
+                continue;
+            }
+            done[vertex] = true;
+
+            Stencil ring;
+            int valence = 0;
+            auto e = edges[edge].opposite;
+            do {
+                ring.push_back({edges[e].vertex, 1.0f});
+                ring.push_back({edges[edges[e].opposite].vertex, 1.0f});
+                addFaceCorners(ring, Quad::edgeFace(e), 0.25f);
+                valence++;
+                e = edges[Quad::nextEdge(e)].opposite;
+            } while (edges[e].opposite != EdgeID(edge));
+
+            float n = valence;
+            auto &stencil = localRows[firstVertexPoint + vertex];
+            stencil.clear();
+            stencil.push_back({vertex, (n - 3.0f) / n});
+            for (auto &term: ring) {
+                stencil.push_back({term.first, term.second / (n * n)});
+            }
+        }
+
+        vector<Stencil> composed(localRows.size());
+        for (size_t i = 0; i < localRows.size(); i++) {
+            composed[i] = compose(localRows[i]);
+        }
+        rows.swap(composed);
+        current = std::move(next);
+    }
+
+    // Flatten composed rows
+    _offsets.reserve(rows.size() + 1);
+    _offsets.push_back(0);
+    for (auto &row: rows) {
+        for (auto &term: row) {
+            _indices.push_back(term.first);
+            _weights.push_back(term.second);
+        }
+        _offsets.push_back(_indices.size());
+    }
+
+    _subdivided = std::move(current);
+}
+
+int SubdivisionPlan::getLevel() const
+{
+    return _level;
+}
+
+size_t SubdivisionPlan::getNumControlVertices() const
+{
+    return _numControlVertices;
+}
+
+size_t SubdivisionPlan::getNumVertices() const
+{
+    return _offsets.size() - 1;
+}
+
+Quad SubdivisionPlan::createQuad() const
+{
+    return _subdivided;
+}
+
+void SubdivisionPlan::evaluate(const ofVec3f *controlPositions, ofVec3f *positions) const
+{
+    auto numRows = _offsets.size() - 1;
+    for (size_t i = 0; i < numRows; i++) {
+        ofVec3f sum = {0.0, 0.0, 0.0};
+        for (auto j = _offsets[i]; j < _offsets[i + 1]; j++) {
+            sum += controlPositions[_indices[j]] * _weights[j];
+        }
+        positions[i] = sum;
+    }
+}
+
+void SubdivisionPlan::update(const Quad &control, Quad &subdivided) const
+{
+    if (control._vertices.size() != _numControlVertices ||
+        subdivided._vertices.size() != getNumVertices()) {
+        throw invalid_argument("mesh does not match subdivision plan");
+    }
+
+    auto numRows = _offsets.size() - 1;
+    for (size_t i = 0; i < numRows; i++) {
+        ofVec3f sum = {0.0, 0.0, 0.0};
+        for (auto j = _offsets[i]; j < _offsets[i + 1]; j++) {
+            sum += control._vertices[_indices[j]].position * _weights[j];
+        }
+        subdivided._vertices[i].position = sum;
+    }
+    subdivided.meshChanged();
+}
@@ -0,0 +1,55 @@
+#ifndef OFXQUAD_SUBDIVISIONPLAN_H
+#define OFXQUAD_SUBDIVISIONPLAN_H
+
+#include "Quad.h"
+#include <vector>
+#include <cstdint>
+
+
+namespace ofx
+{
+
+// Catmull-Clark subdivision flattened into a sparse matrix. Each row of the
+// matrix holds the control vertex indices and weights that produce one
+// vertex of the subdivided mesh, composed across all subdivision levels.
+//
+// Plan is built once from a control mesh. Afterwards, moving the control
+// vertices only requires a single sparse matrix-vector product; topology
+// of the subdivided mesh is never rebuilt.
+class SubdivisionPlan
+{
+public:
+    SubdivisionPlan(const Quad &control, int level=1);
+
+    int getLevel() const;
+    std::size_t getNumControlVertices() const;
+    std::size_t getNumVertices() const;
+
+    // Subdivided mesh with same topology and vertex IDs as plan output.
+    // Positions match control mesh that plan was built from.
+    Quad createQuad() const;
+
+    // Calculate subdivided vertex positions from control vertex positions.
+    // Output array must hold getNumVertices() positions.
+    void evaluate(const ofVec3f *controlPositions, ofVec3f *positions) const;
+
+    // Copy control vertex positions through plan into quad created by
+    // createQuad(). No allocation or topology lookups are done.
+    void update(const Quad &control, Quad &subdivided) const;
+
+private:
+    int _level;
+    std::size_t _numControlVertices;
+
+    // Compressed sparse rows; row i spans [_offsets[i], _offsets[i + 1])
+    std::vector<uint32_t> _offsets;
+    std::vector<VertexID> _indices;
+    std::vector<float> _weights;
+
+    Quad _subdivided;
+};
+
+};
+
+
+#endif
@@ -0,0 +1,230 @@
+#include "SubdivisionSink.h"
+#include "BinaryIO.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace ofx;
+using namespace ofx::binary;
+
+
+namespace
+{
+
+const char magic[8] = {'o', 'f', 'x', 'Q', 'u', 'a', 'd', 'S'};
+
+// Vertices converted to OBJ text per read of temporary file
+const size_t objChunkSize = 65536;
+
+void writeVertex(char *p, const Vertex &vertex)
+{
+    for (int i = 0; i < 3; i++) {
+        writeFloat(p + 4 * i, vertex.position[i]);
+        writeFloat(p + 12 + 4 * i, vertex.normal[i]);
+    }
+}
+
+};
+
+
+CallbackSink::CallbackSink(VerticesFunction vertices, FacesFunction faces, BeginFunction begin,
+                           function<void()> end)
+    : _vertices(vertices), _faces(faces), _begin(begin), _end(end)
+{
+
+}
+
+void CallbackSink::begin(size_t numVertices, size_t numFaces)
+{
+    if (_begin) {
+        _begin(numVertices, numFaces);
+    }
+}
+
+void CallbackSink::addVertices(const VertexID *ids, const Vertex *vertices, size_t count)
+{
+    if (_vertices) {
+        _vertices(ids, vertices, count);
+    }
+}
+
+void CallbackSink::addFaces(const array<VertexID, 4> *faces, size_t count)
+{
+    if (_faces) {
+        _faces(faces, count);
+    }
+}
+
+void CallbackSink::end()
+{
+    if (_end) {
+        _end();
+    }
+}
+
+
+BinaryFileSink::BinaryFileSink(const string &path)
+    : _path(path), _numVertices(0), _numFaces(0), _facesWritten(0)
+{
+
+}
+
+void BinaryFileSink::begin(size_t numVertices, size_t numFaces)
+{
+    _file.open(_path, ios::binary | ios::trunc);
+    if (!_file) {
+        throw runtime_error("Couldn't write file: " + _path);
+    }
+    _numVertices = numVertices;
+    _numFaces = numFaces;
+    _facesWritten = 0;
+
+    char header[headerSize];
+    memcpy(header, magic, sizeof(magic));
+    writeLittle(header + 8, version);
+    writeLittle(header + 12, uint32_t(0));
+    writeLittle(header + 16, uint64_t(numVertices));
+    writeLittle(header + 24, uint64_t(numFaces));
+    _file.write(header, headerSize);
+}
+
+// Sort batch by ID and write each run of consecutive IDs with one seek
+void BinaryFileSink::addVertices(const VertexID *ids, const Vertex *vertices, size_t count)
+{
+    vector<pair<VertexID, size_t>> order(count);
+    for (size_t i = 0; i < count; i++) {
+        if (ids[i] < 0 || size_t(ids[i]) >= _numVertices) {
+            throw out_of_range("vertex ID out of range");
+        }
+        order[i] = {ids[i], i};
+    }
+    sort(order.begin(), order.end());
+
+    vector<char> buffer;
+    for (size_t begin = 0; begin < count;) {
+        auto end = begin + 1;
+        while (end < count && order[end].first == order[end - 1].first + 1) {
+            end++;
+        }
+        buffer.resize((end - begin) * vertexSize);
+        for (auto i = begin; i < end; i++) {
+            writeVertex(&buffer[(i - begin) * vertexSize], vertices[order[i].second]);
+        }
+        _file.seekp(headerSize + size_t(order[begin].first) * vertexSize);
+        _file.write(buffer.data(), buffer.size());
+        begin = end;
+    }
+    if (!_file) {
+        throw runtime_error("Couldn't write file: " + _path);
+    }
+}
+
+void BinaryFileSink::addFaces(const array<VertexID, 4> *faces, size_t count)
+{
+    if (_facesWritten + count > _numFaces) {
+        throw out_of_range("more faces than announced by begin()");
+    }
+    vector<char> buffer(count * 16);
+    for (size_t i = 0; i < count; i++) {
+        for (int k = 0; k < 4; k++) {
+            writeLittle(&buffer[16 * i + 4 * k], uint32_t(faces[i][k]));
+        }
+    }
+    _file.seekp(headerSize + _numVertices * vertexSize + _facesWritten * 16);
+    _file.write(buffer.data(), buffer.size());
+    _facesWritten += count;
+    if (!_file) {
+        throw runtime_error("Couldn't write file: " + _path);
+    }
+}
+
+void BinaryFileSink::end()
+{
+    _file.close();
+    if (!_file) {
+        throw runtime_error("Couldn't write file: " + _path);
+    }
+}
+
+
+ObjFileSink::ObjFileSink(const string &path)
+    : _path(path), _tempPath(path + ".tmp"), _temp(_tempPath)
+{
+
+}
+
+void ObjFileSink::begin(size_t numVertices, size_t numFaces)
+{
+    _temp.begin(numVertices, numFaces);
+}
+
+void ObjFileSink::addVertices(const VertexID *ids, const Vertex *vertices, size_t count)
+{
+    _temp.addVertices(ids, vertices, count);
+}
+
+void ObjFileSink::addFaces(const array<VertexID, 4> *faces, size_t count)
+{
+    _temp.addFaces(faces, count);
+}
+
+// Convert temporary file in chunks: positions, then normals, then faces
+// with 1-based indices shared by position and normal
+void ObjFileSink::end()
+{
+    _temp.end();
+
+    ifstream in(_tempPath, ios::binary);
+    ofstream out(_path);
+    if (!in || !out) {
+        throw runtime_error("Couldn't write file: " + _path);
+    }
+
+    char header[BinaryFileSink::headerSize];
+    in.read(header, sizeof(header));
+    auto numVertices = readLittle<uint64_t>(header + 16);
+    auto numFaces = readLittle<uint64_t>(header + 24);
+
+    vector<char> buffer;
+    char line[128];
+    for (int normals = 0; normals < 2; normals++) {
+        in.seekg(BinaryFileSink::headerSize);
+        for (uint64_t first = 0; first < numVertices; first += objChunkSize) {
+            auto count = min<uint64_t>(objChunkSize, numVertices - first);
+            buffer.resize(count * BinaryFileSink::vertexSize);
+            in.read(buffer.data(), buffer.size());
+            for (size_t i = 0; i < count; i++) {
+                auto p = &buffer[i * BinaryFileSink::vertexSize + 12 * normals];
+                int length = snprintf(line, sizeof(line), normals ? "vn %.9g %.9g %.9g\n" : "v %.9g %.9g %.9g\n",
+                                      readFloat(p), readFloat(p + 4), readFloat(p + 8));
+                out.write(line, length);
+            }
+        }
+    }
+
+    for (uint64_t first = 0; first < numFaces; first += objChunkSize) {
+        auto count = min<uint64_t>(objChunkSize, numFaces - first);
+        buffer.resize(count * 16);
+        in.read(buffer.data(), buffer.size());
+        for (size_t i = 0; i < count; i++) {
+            int32_t v[4];
+            for (int k = 0; k < 4; k++) {
+                v[k] = readLittle<int32_t>(&buffer[16 * i + 4 * k]) + 1;
+            }
+            int length = snprintf(line, sizeof(line), "f %d//%d %d//%d %d//%d %d//%d\n",
+                                  v[0], v[0], v[1], v[1], v[2], v[2], v[3], v[3]);
+            out.write(line, length);
+        }
+    }
+
+    out.close();
+    if (!in || !out) {
+        throw runtime_error("Couldn't write file: " + _path);
+    }
+    in.close();
+    remove(_tempPath.c_str());
+}
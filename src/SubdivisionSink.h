@@ -0,0 +1,117 @@
+#ifndef OFXQUAD_SUBDIVISIONSINK_H
+#define OFXQUAD_SUBDIVISIONSINK_H
+
+#include "Quad.h"
+#include <array>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace ofx
+{
+
+// Receives output of StreamingSubdivision. Vertices arrive in batches, in
+// no particular ID order, and each vertex ID arrives exactly once. Faces
+// refer to vertex IDs, which may not have arrived yet.
+class SubdivisionSink
+{
+public:
+    virtual ~SubdivisionSink() {}
+
+    // Called once before any vertices or faces. Vertex IDs are below
+    // numVertices.
+    virtual void begin(std::size_t numVertices, std::size_t numFaces) = 0;
+
+    virtual void addVertices(const VertexID *ids, const Vertex *vertices, std::size_t count) = 0;
+    virtual void addFaces(const std::array<VertexID, 4> *faces, std::size_t count) = 0;
+
+    // Called once after last vertices and faces
+    virtual void end() = 0;
+};
+
+
+// Sink forwarding batches to functions. Empty functions are skipped.
+class CallbackSink : public SubdivisionSink
+{
+public:
+    typedef std::function<void(std::size_t numVertices, std::size_t numFaces)> BeginFunction;
+    typedef std::function<void(const VertexID *ids, const Vertex *vertices, std::size_t count)>
+        VerticesFunction;
+    typedef std::function<void(const std::array<VertexID, 4> *faces, std::size_t count)> FacesFunction;
+
+    CallbackSink(VerticesFunction vertices, FacesFunction faces, BeginFunction begin=BeginFunction(),
+                 std::function<void()> end=std::function<void()>());
+
+    void begin(std::size_t numVertices, std::size_t numFaces) override;
+    void addVertices(const VertexID *ids, const Vertex *vertices, std::size_t count) override;
+    void addFaces(const std::array<VertexID, 4> *faces, std::size_t count) override;
+    void end() override;
+
+private:
+    VerticesFunction _vertices;
+    FacesFunction _faces;
+    BeginFunction _begin;
+    std::function<void()> _end;
+};
+
+
+// Sink writing a binary file. Vertices are written in place by ID, so file
+// holds them in ID order without keeping them in memory. All values are
+// little-endian:
+//
+//     header:   magic "ofxQuadS" (8 bytes), uint32 version, uint32 zero,
+//               uint64 numVertices, uint64 numFaces
+//     vertices: numVertices * (x, y, z, nx, ny, nz) floats
+//     faces:    numFaces * 4 int32 vertex IDs
+//
+// Throws std::runtime_error if file can't be written.
+class BinaryFileSink : public SubdivisionSink
+{
+public:
+    static const uint32_t version = 1;
+    static const std::size_t headerSize = 32;
+    static const std::size_t vertexSize = 24;
+
+    BinaryFileSink(const std::string &path);
+
+    void begin(std::size_t numVertices, std::size_t numFaces) override;
+    void addVertices(const VertexID *ids, const Vertex *vertices, std::size_t count) override;
+    void addFaces(const std::array<VertexID, 4> *faces, std::size_t count) override;
+    void end() override;
+
+private:
+    std::string _path;
+    std::ofstream _file;
+    std::size_t _numVertices;
+    std::size_t _numFaces;
+    std::size_t _facesWritten;
+};
+
+
+// Sink writing an OBJ file with positions and normals. OBJ needs vertices
+// in ID order before faces, so output goes through a BinaryFileSink at
+// path + ".tmp", which is converted and removed by end(). Throws
+// std::runtime_error if files can't be written.
+class ObjFileSink : public SubdivisionSink
+{
+public:
+    ObjFileSink(const std::string &path);
+
+    void begin(std::size_t numVertices, std::size_t numFaces) override;
+    void addVertices(const VertexID *ids, const Vertex *vertices, std::size_t count) override;
+    void addFaces(const std::array<VertexID, 4> *faces, std::size_t count) override;
+    void end() override;
+
+private:
+    std::string _path;
+    std::string _tempPath;
+    BinaryFileSink _temp;
+};
+
+};
+
+
+#endif